@@ -36,6 +36,9 @@ complex c_div(complex a, complex b) {
 complex c_exp(complex p) {
     return exp(p.x)*c_new(cos(p.y), sin(p.y));
 }
+complex c_log(complex a) {
+    return c_new((real)0.5*log(c_abs2(a)), atan2(a.y, a.x));
+}
 complex c_powr(complex a, real p) {
     real r = pow(c_abs2(a), p/2);
     real phi = p*atan2(a.y, a.x);
@@ -30,6 +30,8 @@ complex c_inverse(complex a);
 complex c_div(complex a, complex b);
 
 complex c_exp(complex p);
+// Principal logarithm, `c_powr(a, p) == c_exp(p*c_log(a))`.
+complex c_log(complex a);
 complex c_powr(complex a, real p);
 complex c_sqrt(complex a);
 
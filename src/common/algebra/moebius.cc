@@ -27,10 +27,97 @@ Moebius mo_interpolate(Moebius a, Moebius b, real t) {
     return mo_chain(a, mo_pow(mo_chain(mo_inverse(a), b), t));
 }
 
+MoebiusPath mo_path_new(Moebius a, Moebius b) {
+    MoebiusPath p;
+    Moebius m = mo_chain(mo_inverse(a), b);
+    Moebius x = mo_sub(m, mo_identity());
+    real y = mo_fabs(x);
+    p.log0 = C0;
+    p.log1 = C0;
+    p.shear = C0;
+    // The same threshold as in `mo_pow`.
+    if (y*y > 1e4*EPS) {
+        Moebius j, v;
+        complex2x2_eigen(m, &j, &v);
+        p.left = mo_chain(a, v);
+        p.right = complex2x2_inverse(v);
+        p.linear = false;
+        p.log0 = c_log(j.s[0]);
+        p.log1 = c_log(j.s[3]);
+        if (c_fabs(j.s[1]) >= EPS) {
+            p.shear = c_div(j.s[1], j.s[0]);
+        }
+    } else {
+        p.left = a;
+        p.right = x;
+        p.linear = true;
+    }
+    return p;
+}
+
+// The middle factor of the path at `t`, it is the power of the Jordan form
+// or the linear approximation, so that `k(a + b) == k(a)*k(b)`.
+Moebius _mo_path_middle(const MoebiusPath *path, real t) {
+    if (path->linear) {
+        return mo_add(mo_identity(), mo_mul(path->right, c_new(t, R0)));
+    }
+    complex e0 = c_exp(t*path->log0);
+    return mo_new(e0, t*c_mul(e0, path->shear), C0, c_exp(t*path->log1));
+}
+
+Moebius mo_path_at(const MoebiusPath *path, real t) {
+    Moebius k = _mo_path_middle(path, t);
+    if (path->linear) {
+        return mo_chain(path->left, k);
+    }
+    return mo_chain(mo_chain(path->left, k), path->right);
+}
+
+MoebiusPath mo_path_sub(const MoebiusPath *path, real a, real b) {
+    MoebiusPath p = *path;
+    real d = b - a;
+    Moebius k = _mo_path_middle(path, a);
+    p.left = mo_chain(path->left, k);
+    if (path->linear) {
+        // `left*(k + u*d*x)` is `left*k*(1 + u*k^-1*d*x)`.
+        p.right = mo_mul(mo_chain(complex2x2_inverse(k), path->right), c_new(d, R0));
+    } else {
+        p.log0 = d*path->log0;
+        p.log1 = d*path->log1;
+        p.shear = d*path->shear;
+    }
+    return p;
+}
+
 real mo_diff(Moebius a, Moebius b) {
     return mo_fabs(mo_sub(a, b));
 }
 
+#ifdef OPENCL_INTEROP
+
+MoebiusPathPk mo_path_pack(MoebiusPath p) {
+    MoebiusPathPk o;
+    o.left = mo_pack(p.left);
+    o.right = mo_pack(p.right);
+    o.linear = (int_pk)p.linear;
+    o.log0 = c_pack(p.log0);
+    o.log1 = c_pack(p.log1);
+    o.shear = c_pack(p.shear);
+    return o;
+}
+MoebiusPath mo_path_unpack(MoebiusPathPk p) {
+    MoebiusPath o;
+    o.left = mo_unpack(p.left);
+    o.right = mo_unpack(p.right);
+    o.linear = p.linear != 0;
+    o.log0 = c_unpack(p.log0);
+    o.log1 = c_unpack(p.log1);
+    o.shear = c_unpack(p.shear);
+    return o;
+}
+
+#endif // OPENCL_INTEROP
+
 
 #ifdef UNIT_TEST
 #include <catch.hpp>
@@ -168,5 +255,30 @@ TEST_CASE("Moebius transformation", "[moebius]") {
             REQUIRE(o == ApproxMo(m));
         }
     }
+
+    SECTION("Precomputed interpolation") {
+        for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+            Moebius a = random_moebius(rng), b;
+            switch (i % 3) {
+            case 0:
+                b = random_moebius(rng);
+                break;
+            case 1:
+                // Parabolic relative map.
+                b = mo_chain(a, mo_new(C1, rand_c_normal(rng), C0, C1));
+                break;
+            default:
+                b = mo_chain(a, mo_new(C1, c_new(1e-6, 0), C0, C1));
+                break;
+            }
+            MoebiusPath path = mo_path_new(a, b);
+            real t = rng.uniform();
+            REQUIRE(mo_path_at(&path, t) == ApproxMo(mo_interpolate(a, b, t)));
+
+            real s0 = rng.uniform(), s1 = rng.uniform();
+            MoebiusPath sub = mo_path_sub(&path, s0, s1);
+            REQUIRE(mo_path_at(&sub, t) == ApproxMo(mo_path_at(&path, s0 + (s1 - s0)*t)));
+        }
+    }
 };
 #endif // UNIT_TEST
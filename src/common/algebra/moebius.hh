@@ -27,6 +27,27 @@ quaternion mo_deriv(Moebius m, quaternion p, quaternion v);
 #define mo_pow complex2x2_pow
 Moebius mo_interpolate(Moebius a, Moebius b, real t);
 
+// Interpolation from `a` to `b` with the eigendecomposition
+// of the relative map `a^-1*b` done once by `mo_path_new`.
+// Then `mo_path_at` takes only the exponentials of the eigenvalue logarithms.
+typedef struct {
+    // `a*v` and `v^-1`, where `v` is the eigenbasis of the relative map.
+    // If the map is close to identity they are `a` and `a^-1*b - 1`,
+    // and the map is interpolated linearly as in `mo_pow`.
+    Moebius left, right;
+    bool linear;
+    // Logarithms of the eigenvalues.
+    complex log0, log1;
+    // Off-diagonal element of the Jordan form divided by the eigenvalue,
+    // zero if the map is diagonalizable.
+    complex shear;
+} MoebiusPath;
+
+MoebiusPath mo_path_new(Moebius a, Moebius b);
+Moebius mo_path_at(const MoebiusPath *path, real t);
+// Part of the `path` from `a` to `b` parametrized from 0 to 1.
+MoebiusPath mo_path_sub(const MoebiusPath *path, real a, real b);
+
 #define mo_add complex2x2_add
 #define mo_sub complex2x2_sub
 #define mo_mul complex2x2_mul
@@ -40,6 +61,16 @@ real mo_diff(Moebius a, Moebius b);
 #define unpack_moebius unpack_complex2x2
 #define mo_pack pack_moebius
 #define mo_unpack unpack_moebius
+
+typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
+    MoebiusPk left, right;
+    int_pk linear;
+    complex_pk log0, log1;
+    complex_pk shear;
+} MoebiusPathPk;
+
+MoebiusPathPk mo_path_pack(MoebiusPath p);
+MoebiusPath mo_path_unpack(MoebiusPathPk p);
 #endif // OPENCL_INTEROP
 
 
@@ -0,0 +1,177 @@
+#include "bvh.hh"
+
+#ifndef OPENCL
+#include <math.h>
+#endif // OPENCL
+
+
+BvhRay bvh_ray_init(HyRay ray) {
+    BvhRay r;
+    quaternion p = ray.start, d = normalize(ray.direction);
+    real dh = length(d.xy);
+    r.start = p;
+    if (dh < EPS) {
+        r.dir = make_real2(R0, R0);
+        r.center = R0;
+        r.end = d.z > (real)0 ? R1 : -R1;
+    } else {
+        r.dir = d.xy/dh;
+        r.center = p.z*d.z/dh;
+        // Both forms are equal, the choice avoids cancellation.
+        if (d.z >= (real)0) {
+            r.end = p.z*((real)1 + d.z)/dh;
+        } else {
+            r.end = p.z*dh/((real)1 - d.z);
+        }
+    }
+    return r;
+}
+
+bool bvh_ball_hit(const BvhRay *ray, quaternion center, real radius) {
+    quaternion p = ray->start;
+    real2 c = center.xy - p.xy;
+    real r2 = radius*radius;
+
+    if (ray->dir.x == (real)0 && ray->dir.y == (real)0) {
+        real z = center.z;
+        if (ray->end > (real)0) {
+            z = max(z, p.z);
+        } else {
+            z = clamp(z, (real)0, p.z);
+        }
+        return dot(c, c) + (center.z - z)*(center.z - z) <= r2;
+    }
+
+    // Cut the ball by the plane of the geodesic.
+    real dp = ray->dir.x*c.y - ray->dir.y*c.x;
+    r2 -= dp*dp;
+    if (r2 < (real)0) {
+        return false;
+    }
+    // Center of the cut disk in the plane coordinates.
+    real h = dot(ray->dir, c), z = center.z;
+    real a = ray->center;
+
+    // Endpoints of the arc.
+    if (h*h + (p.z - z)*(p.z - z) <= r2) {
+        return true;
+    }
+    if ((ray->end - h)*(ray->end - h) + z*z <= r2) {
+        return true;
+    }
+
+    // Distance from the disk center to the geodesic circle
+    // is `|e - R|` where `e^2 - R^2 = k`.
+    real k = h*h - (real)2*h*a + z*z - p.z*p.z;
+    real e = sqrt((h - a)*(h - a) + z*z);
+    real R = sqrt(a*a + p.z*p.z);
+    if (k*k > r2*(e + R)*(e + R)) {
+        return false;
+    }
+    // The nearest point of the circle must be inside the arc.
+    return z >= (real)0 && h*p.z + a*(z - p.z) >= (real)0;
+}
+
+bool object_bound(const ObjectInstance *object, quaternion *center, real *radius) {
+    // Copies of the repeated objects fill the whole space.
+    if (object->group >= 0) {
+        return false;
+    }
+    Moebius m = object->map;
+    complex a = m.s[0], b = m.s[1], c = m.s[2], d = m.s[3];
+    if (object->type == OBJECT_HOROSPHERE) {
+        // The horosphere touches the boundary at the image of the infinity.
+        if (c_abs2(c) < EPS) {
+            return false;
+        }
+        complex o = c_div(a, c);
+        quaternion q = mo_apply(m, QJ);
+        complex u = q.xy - o;
+        real h = (c_abs2(u) + q.z*q.z)/q.z;
+        *center = q_new(o, (real)0.5*h, R0);
+        *radius = (real)0.5*h;
+        return true;
+    } else if (object->type == OBJECT_HYPLANE) {
+        // Image of the unit circle at the boundary.
+        real k = c_abs2(d) - c_abs2(c);
+        if (fabs(k) < EPS) {
+            return false;
+        }
+        complex o = (c_mul(c_conj(d), b) - c_mul(c_conj(c), a))/k;
+        real r2 = c_abs2(o) - (c_abs2(b) - c_abs2(a))/k;
+        *center = q_new(o, R0, R0);
+        *radius = sqrt(max(r2, (real)0));
+        return true;
+    }
+    return false;
+}
+
+
+#ifdef UNIT_TEST
+#include <catch.hpp>
+
+#include <geometry/hyperbolic.hh>
+
+TEST_CASE("Bounding volume hierarchy", "[bvh]") {
+    TestRng rng;
+
+    SECTION("Object bounds") {
+        for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+            ObjectInstance obj;
+            obj.map = random_moebius(rng);
+            obj.group = -1;
+            quaternion center;
+            real radius;
+
+            obj.type = OBJECT_HOROSPHERE;
+            REQUIRE(object_bound(&obj, &center, &radius));
+            for (int j = 0; j < TEST_ATTEMPTS; ++j) {
+                quaternion p = mo_apply(obj.map, q_new(rand_c_normal(rng), 1, 0));
+                REQUIRE(length(p - center) == Approx(radius));
+            }
+
+            obj.type = OBJECT_HYPLANE;
+            REQUIRE(object_bound(&obj, &center, &radius));
+            for (int j = 0; j < TEST_ATTEMPTS; ++j) {
+                complex u = rand_c_unit(rng);
+                real z = rng.uniform();
+                quaternion p = mo_apply(obj.map, q_new(sqrt(1 - z*z)*u, z, 0));
+                REQUIRE(length(p - center) == Approx(radius));
+            }
+        }
+    }
+
+    SECTION("Ray and ball intersection") {
+        for (int i = 0; i < 16*TEST_ATTEMPTS; ++i) {
+            HyRay ray;
+            ray.start = q_new(rand_c_normal(rng), exp(rng.normal()), 0);
+            ray.direction = normalize(rand_q_normal(rng)*q_new(1, 1, 1, 0));
+            if (i % 8 == 0) {
+                ray.direction = q_new(0, 0, rng.uniform() > 0.5 ? 1 : -1, 0);
+            }
+            quaternion center = q_new(rand_c_normal(rng), 2*rng.uniform(), 0);
+            real radius = exp(0.5*rng.normal() - 0.5);
+
+            // Walk along the geodesic with small steps.
+            Moebius m = hy_move_at(ray.start);
+            HyRay local = hyray_map(m, ray);
+            Moebius b = mo_chain(mo_inverse(m), mo_inverse(hy_look_to(local.direction)));
+            real dist = -1;
+            for (int j = 0; j < 20000; ++j) {
+                quaternion p = mo_apply(b, q_new(0, 0, exp(0.001*j), 0));
+                real l = length(p - center)/radius;
+                if (dist < 0 || l < dist) {
+                    dist = l;
+                }
+            }
+
+            BvhRay br = bvh_ray_init(ray);
+            if (dist < 0.99) {
+                REQUIRE(bvh_ball_hit(&br, center, radius));
+            } else if (dist > 1.01) {
+                REQUIRE(!bvh_ball_hit(&br, center, radius));
+            }
+        }
+    }
+};
+#endif // UNIT_TEST
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <types.hh>
+
+#include <algebra/real.hh>
+#include <algebra/quaternion.hh>
+#include <geometry/hyperbolic/ray.hh>
+
+#include <object.hh>
+
+
+// Bounding volume hierarchy over the objects of the scene.
+//
+// Bounding volumes are Euclidean balls in the Poincare half-space model.
+// A ball lying above the boundary is a hyperbolic ball, a ball tangent to
+// the boundary is a horoball, and a ball centered at the boundary bounds
+// a hyperbolic plane. Objects passing through the infinity cannot be bounded,
+// so they are stored separately and tested for every ray.
+
+#define BVH_LEAF_SIZE 4
+
+// Geodesic ray prepared for testing against bounding balls.
+// The geodesic lies in the vertical plane passing through `start`
+// along the horizontal direction `dir`. It is an arc of the circle
+// centered at `center` (relative to `start` along `dir`) at the boundary,
+// and it ends at the boundary at `end`. If the geodesic is vertical
+// then `dir` is zero and `end` is the sign of the vertical direction.
+typedef struct {
+    quaternion start;
+    real2 dir;
+    real center;
+    real end;
+} BvhRay;
+
+BvhRay bvh_ray_init(HyRay ray);
+
+// Checks whether the ray intersects the ball.
+bool bvh_ball_hit(const BvhRay *ray, quaternion center, real radius);
+
+// Computes the bounding ball of the object.
+// Returns `false` if the object is unbounded in the half-space model.
+bool object_bound(const ObjectInstance *object, quaternion *center, real *radius);
+
+
+#ifdef OPENCL_INTEROP
+
+// Nodes are stored in depth-first order, so the next node to visit
+// after the hit of the ball always follows it. `skip` is the index of the node
+// to visit when the ball is missed. Leaves have non-zero `count`
+// of object indices starting from `first`.
+typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
+    real4_pk ball;
+    int_pk first;
+    int_pk count;
+    int_pk skip;
+} BvhNodePk;
+
+#endif // OPENCL_INTEROP
@@ -6,7 +6,14 @@
 
 
 real hy_distance(quaternion a, quaternion b) {
-    real x = (real)1 + q_abs2(a - b)/((real)2*a.z*b.z);
+    return hy_acosh(hy_cosh_distance(a, b));
+}
+
+real hy_cosh_distance(quaternion a, quaternion b) {
+    return (real)1 + q_abs2(a - b)/((real)2*a.z*b.z);
+}
+
+real hy_acosh(real x) {
     return log(x + sqrt(x*x - 1));
 }
 
@@ -5,6 +5,10 @@
 
 
 real hy_distance(quaternion a, quaternion b);
+// Hyperbolic cosine of the distance, it is cheaper and grows with the distance,
+// so it is enough to compare the distances.
+real hy_cosh_distance(quaternion a, quaternion b);
+real hy_acosh(real x);
 
 // Returns the direction of the line at point `dst_pos`
 // when we know that the line at the point `src_pos` has direction of `src_dir`.
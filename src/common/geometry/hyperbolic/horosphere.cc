@@ -4,7 +4,7 @@
 
 
 bool horosphere_hit(
-    const Object *plane, ObjectHit *cache,
+    const ObjectGeometry *plane, ObjectHit *cache,
     PathInfo *path, HyRay ray
 ) {
     bool face = true;
@@ -33,7 +33,6 @@ bool horosphere_hit(
     );
 
     cache->pos = h;
-    cache->dir = hy_dir_at(p, d, h);
 
     path->face = face;
 
@@ -13,8 +13,9 @@
 #define HOROSPHERE_TILING_HEXAGONAL 2
 
 
+// Only the position of the hit is stored, see `hyplane_hit`.
 bool horosphere_hit(
-    const Object *horosphere, ObjectHit *cache,
+    const ObjectGeometry *horosphere, ObjectHit *cache,
     PathInfo *path, HyRay ray
 );
 
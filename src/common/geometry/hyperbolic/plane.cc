@@ -4,7 +4,7 @@
 
 
 bool hyplane_hit(
-    const Object *plane, ObjectHit *cache,
+    const ObjectGeometry *plane, ObjectHit *cache,
     PathInfo *path, HyRay ray
 ) {
     // Line cannot intersect plane twice
@@ -36,7 +36,6 @@ bool hyplane_hit(
     h.z = sqrt((real)1 - pxy2);
 
     cache->pos = h;
-    cache->dir = hy_dir_at(p, d, h);
 
     return true;
 }
@@ -47,20 +46,21 @@ void hyplane_bounce(
     Material *material
 ) {
     if (
-        plane->tiling.type == HYPLANE_TILING_PENTAGONAL ||
-        plane->tiling.type == HYPLANE_TILING_PENTASTAR
+        (TILING_ENABLED(HYPLANE_TILING_PENTAGONAL) &&
+            plane->tiling.type == HYPLANE_TILING_PENTAGONAL) ||
+        (TILING_ENABLED(HYPLANE_TILING_PENTASTAR) &&
+            plane->tiling.type == HYPLANE_TILING_PENTASTAR)
     ) {
+#ifdef OPENCL
+        const PentagonalTiling t = PENTAGONAL_TILING;
+#else // OPENCL
+        static const PentagonalTiling t = pentagonal_tiling_new();
+#endif // OPENCL
+        const real L = t.edge, K = t.star;
         quaternion p = cache->pos;
 
         bool w = false;
         //uint n = 0, b = 1;
-        real Q = sqrt(cos(PI/4 + PI/5)/cos(PI/4 - PI/5));
-        real T = sqrt(cos(PI/4 + PI/5)*cos(PI/4 - PI/5));
-        real S = (cos(PI/4) - sin(PI/5))/T;
-        real L = T/cos(PI/4);
-        real K = L*(2*cos(PI/5) - 1/cos(PI/5));
-        Q = log((1 + Q)/(1 - Q));
-        S = log((1 + S)/(1 - S));
 
         if (p.x < (real)0) {
             p.x = -p.x;
@@ -74,17 +74,12 @@ void hyplane_bounce(
         }
         //b *= 4;
 
-        p = mo_apply(mo_chain(
-            hy_xshift(-Q),
-            hy_zrotate(-PI/4)
-        ), p);
+        p = mo_apply(t.center, p);
         bool e = false;
         for (int j = 0; j < 5; ++j) {
             bool a[3] = {false};
             for (int i = 0; i < 3 - e; ++i) {
-                real o = 2*PI*(i - 1)/5;
-                real2 d = make_real2(cos(o), sin(o));
-                a[i] = (dot(d, p.xy) < L);
+                a[i] = (dot(t.fold_dir[i], p.xy) < L);
             }
             a[2] = a[2] || e;
             int s = (int)a[0] + (int)a[1] + (int)a[2];
@@ -93,24 +88,13 @@ void hyplane_bounce(
                 break;
             } else if (s == 2) {
                 int i = (!a[1]) + 2*(!a[2]);
-                real o = 2*PI*(i - 1)/5;
-                p = mo_apply(mo_chain(
-                    hy_zrotate(-PI/5),
-                    mo_chain(
-                        hy_xshift(-2*S),
-                        hy_zrotate(-o)
-                    )
-                ), p);
+                p = mo_apply(t.edge_fold[i], p);
                 //n += b*(2*i + 1);
                 e = true;
                 w = !w;
             } else {
                 int i = a[0];
-                real o = PI*(2*i - 1)/5;
-                p = mo_apply(mo_chain(
-                    hy_xshift(-2*Q),
-                    hy_zrotate(-o)
-                ), p);
+                p = mo_apply(t.vertex_fold[i], p);
                 //n += b*(2*(i + 1));
                 e = false;
             }
@@ -120,10 +104,12 @@ void hyplane_bounce(
         const real br = plane->tiling.border_width;
         bool bh = 0;
         for (int i = 0; i < 5; ++i) {
-            real o = 2*PI*i/5;
-            real2 d = make_real2(cos(o), sin(o));
+            real2 d = t.edge_dir[i];
             bh = bh || (dot(d, p.xy) > (L - br*p.z));
-            if (plane->tiling.type == HYPLANE_TILING_PENTASTAR) {
+            if (
+                TILING_ENABLED(HYPLANE_TILING_PENTASTAR) &&
+                plane->tiling.type == HYPLANE_TILING_PENTASTAR
+            ) {
                 real ps = K + dot(d, p.xy);
                 w = w^(ps < 0);
                 bh = bh || (fabs(ps) < br*p.z);
@@ -138,6 +124,28 @@ void hyplane_bounce(
         } else {
             *material = plane->tiling.border_material;
         }
+    } else if (
+        (TILING_ENABLED(HYPLANE_TILING_REGULAR) &&
+            plane->tiling.type == HYPLANE_TILING_REGULAR) ||
+        (TILING_ENABLED(HYPLANE_TILING_APEIROGONAL) &&
+            plane->tiling.type == HYPLANE_TILING_APEIROGONAL)
+    ) {
+        const Tiling *t = &plane->tiling;
+        real dist;
+        int n;
+        if (TILING_ENABLED(HYPLANE_TILING_REGULAR) && t->type == HYPLANE_TILING_REGULAR) {
+            n = regular_tiling_fold(t->p, t->edge, t->rotation, cache->pos, &dist);
+        } else {
+            n = apeirogonal_tiling_fold(t->edge, cache->pos, &dist);
+        }
+        // Hyperbolic sine of the border half-width is close to itself.
+        if (dist < t->border_width) {
+            *material = t->border_material;
+        } else if ((t->q % 2) == 0 && (n % 2) == 1 && plane->material_count >= 2) {
+            *material = plane->materials[1];
+        } else {
+            *material = plane->materials[0];
+        }
     } else {
         *material = plane->materials[0];
     }
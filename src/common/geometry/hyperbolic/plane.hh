@@ -5,15 +5,28 @@
 #include <object.hh>
 #include <material.hh>
 #include "ray.hh"
+#include "tiling.hh"
 
 
 #define HYPLANE_TILING_NONE       0
 #define HYPLANE_TILING_PENTAGONAL 1
 #define HYPLANE_TILING_PENTASTAR  2
+// Generic `{p,q}` and `{inf,q}` tilings, cells are colored
+// alternately when `q` is even.
+#define HYPLANE_TILING_REGULAR     3
+#define HYPLANE_TILING_APEIROGONAL 4
 
+// Bit mask of the tiling types the kernel handles, see `SCENE_OBJECT_TYPES`.
+#ifndef SCENE_TILING_TYPES
+#define SCENE_TILING_TYPES 0xff
+#endif // SCENE_TILING_TYPES
+#define TILING_ENABLED(type) (((SCENE_TILING_TYPES) >> (type)) & 1)
 
+
+// Only the position of the hit is stored to the `cache`,
+// the direction is computed for the nearest hit by `object_hit_complete`.
 bool hyplane_hit(
-    const Object *plane, ObjectHit *cache,
+    const ObjectGeometry *plane, ObjectHit *cache,
     PathInfo *path, HyRay ray
 );
 
@@ -0,0 +1,213 @@
+#include "tiling.hh"
+
+#include <geometry/hyperbolic.hh>
+
+#ifndef OPENCL
+#include <assert.h>
+#endif // OPENCL
+
+
+PentagonalTiling pentagonal_tiling_new() {
+    PentagonalTiling t;
+
+    real Q = sqrt(cos(PI/4 + PI/5)/cos(PI/4 - PI/5));
+    real T = sqrt(cos(PI/4 + PI/5)*cos(PI/4 - PI/5));
+    real S = (cos(PI/4) - sin(PI/5))/T;
+    real L = T/cos(PI/4);
+    real K = L*(2*cos(PI/5) - 1/cos(PI/5));
+    Q = log((1 + Q)/(1 - Q));
+    S = log((1 + S)/(1 - S));
+
+    t.edge = L;
+    t.star = K;
+    t.center = mo_chain(hy_xshift(-Q), hy_zrotate(-PI/4));
+    for (int i = 0; i < 3; ++i) {
+        real o = 2*PI*(i - 1)/5;
+        t.edge_fold[i] = mo_chain(
+            hy_zrotate(-PI/5),
+            mo_chain(hy_xshift(-2*S), hy_zrotate(-o))
+        );
+        t.fold_dir[i] = make_real2(cos(o), sin(o));
+    }
+    for (int i = 0; i < 2; ++i) {
+        real o = PI*(2*i - 1)/5;
+        t.vertex_fold[i] = mo_chain(hy_xshift(-2*Q), hy_zrotate(-o));
+    }
+    for (int i = 0; i < 5; ++i) {
+        real o = 2*PI*i/5;
+        t.edge_dir[i] = make_real2(cos(o), sin(o));
+    }
+
+    return t;
+}
+
+
+real regular_tiling_edge(int p, int q) {
+#ifndef OPENCL
+    // The tiling is hyperbolic only if `1/p + 1/q < 1/2`.
+    assert((p - 2)*(q - 2) > 4);
+#endif // OPENCL
+    // Distance from the center to the edge midpoint.
+    real ch = cos(PI/q)/sin(PI/p);
+    return sqrt(ch*ch - 1)/ch;
+}
+
+real apeirogonal_tiling_height(int q) {
+#ifndef OPENCL
+    assert(q > 2);
+#endif // OPENCL
+    // Edges are the circles of unit spacing, and
+    // the angle between the neighboring edges is `2*PI/q`.
+    real c = -cos(2*PI/q);
+    return sqrt((1 + c)/(1 - c))/2;
+}
+
+int regular_tiling_fold(
+    int p, real edge, complex rotation,
+    quaternion pos, real *dist
+) {
+    // Homogeneous coordinates on the hyperboloid. The edge `i` has
+    // the spacelike normal `(u_i, edge)`, reflections are linear maps.
+    const real nn = 1 - edge*edge;
+    real3 v = make_real3(pos.x, pos.y, (real)1);
+    int n = 0;
+    real s_max = (real)0;
+    for (int k = 0; k <= TILING_MAX_STEPS; ++k) {
+        s_max = -INFINITY;
+        complex u = C1, u_max = C1;
+        for (int i = 0; i < p; ++i) {
+            real s = dot(u, v.xy) - edge*v.z;
+            if (s > s_max) {
+                s_max = s;
+                u_max = u;
+            }
+            u = c_mul(u, rotation);
+        }
+        if (s_max <= (real)0 || k == TILING_MAX_STEPS) {
+            break;
+        }
+        real f = (real)2*s_max/nn;
+        v = make_real3(v.xy - f*u_max, v.z - f*edge);
+        n += 1;
+    }
+    *dist = -s_max/sqrt(nn*(v.z*v.z - dot(v.xy, v.xy)));
+    return n;
+}
+
+int apeirogonal_tiling_fold(
+    real height,
+    quaternion pos, real *dist
+) {
+    const real r2 = height*height + (real)0.25;
+    // Poincare disk, then the half-plane with the center at infinity.
+    complex d = pos.xy/((real)1 + pos.z);
+    complex w = c_div(c_mul(CI, C1 + d), C1 - d);
+    int n = 0;
+    for (int k = 0; k <= TILING_MAX_STEPS; ++k) {
+        // The tiling is periodic along the horocycles, so the point
+        // is moved to the edge circle centered at zero.
+        w.x -= floor(w.x + (real)0.5);
+        real a = dot(w, w);
+        if (a >= r2 || k == TILING_MAX_STEPS) {
+            break;
+        }
+        // Inversion in the edge circle.
+        w *= r2/a;
+        n += 1;
+    }
+    // The nearest edge is either below the point or the neighbor one.
+    complex c = c_new(w.x < (real)0 ? (real)-1 : (real)1, (real)0);
+    real e = fmin(dot(w, w), dot(w - c, w - c)) - r2;
+    *dist = e/((real)2*sqrt(r2)*w.y);
+    return n;
+}
+
+
+#ifdef UNIT_TEST
+#include <catch.hpp>
+
+#include <vector>
+
+TEST_CASE("Pentagonal tiling", "[tiling]") {
+    TestRng rng;
+    PentagonalTiling t = pentagonal_tiling_new();
+
+    SECTION("Folds keep points on the plane") {
+        std::vector<Moebius> folds = {
+            t.center,
+            t.edge_fold[0], t.edge_fold[1], t.edge_fold[2],
+            t.vertex_fold[0], t.vertex_fold[1]
+        };
+        for (const Moebius &m : folds) {
+            for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+                complex u = rand_c_unit(rng);
+                real z = rng.uniform();
+                quaternion p = mo_apply(m, q_new(sqrt(1 - z*z)*u, z, 0));
+                REQUIRE(length(p) == Approx(1));
+            }
+        }
+    }
+};
+
+// Point of the plane from the Poincare disk.
+static quaternion disk_to_plane(complex d) {
+    real d2 = c_abs2(d);
+    return q_new(2*d/(1 + d2), (1 - d2)/(1 + d2), 0);
+}
+
+TEST_CASE("Regular tilings", "[tiling]") {
+    TestRng rng;
+
+    SECTION("Pentagonal edge") {
+        REQUIRE(regular_tiling_edge(5, 4) == Approx(pentagonal_tiling_new().edge));
+    }
+
+    SECTION("Folding is invariant under edge reflections") {
+        const int pqs[][2] = {{5, 4}, {7, 3}, {4, 6}, {8, 8}};
+        for (const auto &pq : pqs) {
+            int p = pq[0], q = pq[1];
+            real edge = regular_tiling_edge(p, q);
+            complex rotation = c_new(cos(2*PI/p), sin(2*PI/p));
+            for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+                quaternion a = disk_to_plane(0.9*rng.uniform()*rand_c_unit(rng));
+                // Reflection in the edge with the normal `u`.
+                real o = 2*PI*floor(p*rng.uniform())/p;
+                complex u = c_new(cos(o), sin(o));
+                real s = dot(u, a.xy) - edge, f = 2*s/(1 - edge*edge);
+                complex k = (a.xy - f*u)/(1 - f*edge);
+                quaternion b = q_new(k, sqrt(1 - c_abs2(k)), 0);
+
+                real da, db;
+                int na = regular_tiling_fold(p, edge, rotation, a, &da);
+                int nb = regular_tiling_fold(p, edge, rotation, b, &db);
+                REQUIRE(da == Approx(db).margin(1e-6));
+                if (q % 2 == 0) {
+                    REQUIRE((na + nb) % 2 == 1);
+                }
+            }
+        }
+    }
+
+    SECTION("Apeirogonal folding is invariant under edge reflections") {
+        const int qs[] = {3, 4, 6};
+        for (int q : qs) {
+            real h = apeirogonal_tiling_height(q);
+            real r2 = h*h + 0.25;
+            for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+                complex w = c_new(4*rng.uniform() - 2, 0.5 + 2*rng.uniform());
+                // Inversion in the circle of the edge centered at `1`.
+                complex c = c_new(1, 0), wc = w - c;
+                complex v = c + wc*(r2/c_abs2(wc));
+
+                real dw, dv;
+                int nw = apeirogonal_tiling_fold(h, disk_to_plane(c_div(w - CI, w + CI)), &dw);
+                int nv = apeirogonal_tiling_fold(h, disk_to_plane(c_div(v - CI, v + CI)), &dv);
+                REQUIRE(dw == Approx(dv).margin(1e-6));
+                if (q % 2 == 0) {
+                    REQUIRE((nw + nv) % 2 == 1);
+                }
+            }
+        }
+    }
+};
+#endif // UNIT_TEST
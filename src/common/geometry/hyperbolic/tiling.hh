@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algebra/complex.hh>
+#include <algebra/quaternion.hh>
+#include <algebra/moebius.hh>
+
+
+// Constants of the {5,4} pentagonal tiling of the hyperbolic plane.
+// On the device they are compile-time constants from `gen/config.cl`,
+// on the host they are computed once on the first use.
+typedef struct {
+    // Distance from the center of a pentagon to its edges
+    // (in the coordinates of the plane projection).
+    real edge;
+    // The same for the lines of the pentagram.
+    real star;
+    // Moves the corner of the first quadrant to the center of a pentagon.
+    Moebius center;
+    // Reflections through the edge `i - 1` and through the vertex
+    // `i` which fold a point towards the central pentagon.
+    Moebius edge_fold[3];
+    Moebius vertex_fold[2];
+    // Normals of the edges the fold tests against.
+    real2 fold_dir[3];
+    // Normals of all edges of the pentagon.
+    real2 edge_dir[5];
+} PentagonalTiling;
+
+PentagonalTiling pentagonal_tiling_new();
+
+
+// Generic regular {p,q} tilings. The point is folded into the central
+// cell by reflections in the cell edges. Every reflection moves the point
+// closer to the cell, and the number of steps is limited, so the cost
+// doesn't grow with the distance (points beyond the limit are closer
+// to the absolute than the single precision can resolve anyway).
+#define TILING_MAX_STEPS 32
+
+// Distance from the center of the {p,q} polygon to its edges
+// in the coordinates of the plane projection (Klein model).
+real regular_tiling_edge(int p, int q);
+// Height of the vertices of the {inf,q} apeirogon in the half-plane
+// model where the edges are circles centered at integer points.
+real apeirogonal_tiling_height(int q);
+
+// `pos` is a point on the plane, `edge` and `rotation` (by `2*PI/p`)
+// are the precomputed constants. Returns the number of reflections made,
+// `dist` is set to the hyperbolic sine of distance to the nearest edge.
+int regular_tiling_fold(
+    int p, real edge, complex rotation,
+    quaternion pos, real *dist
+);
+// The center of the apeirogon is the point (1, 0) of the plane projection.
+int apeirogonal_tiling_fold(
+    real height,
+    quaternion pos, real *dist
+);
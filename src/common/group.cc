@@ -0,0 +1,346 @@
+#include "group.hh"
+
+#include <geometry/hyperbolic.hh>
+
+
+int _group_find(const Group *group, Moebius g) {
+    for (int k = 0; k < group->count; ++k) {
+        if (mo_diff(g, group->generators[k]) < EPS) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+// Adds the generator together with its inverse,
+// returns false if they don't fit.
+bool _group_add(Group *group, Moebius g) {
+    if (_group_find(group, g) >= 0) {
+        return true;
+    }
+    Moebius inv = mo_inverse(g);
+    int k = group->count;
+    if (mo_diff(inv, g) < EPS) {
+        if (k + 1 > GROUP_GENERATORS_MAX) {
+            return false;
+        }
+        group->generators[k] = g;
+        group->inverse[k] = k;
+        group->count += 1;
+    } else {
+        if (k + 2 > GROUP_GENERATORS_MAX) {
+            return false;
+        }
+        group->generators[k] = g;
+        group->generators[k + 1] = inv;
+        group->inverse[k] = k + 1;
+        group->inverse[k + 1] = k;
+        group->count += 2;
+    }
+    return true;
+}
+
+void _group_derive(Group *group) {
+    for (int k = 0; k < group->count; ++k) {
+        quaternion a = mo_apply(group->generators[k], QJ);
+        group->images[k] = a;
+
+        // Bisector of *j* and *a* is the hemisphere of radius
+        // `sqrt(a.z)` when *a* is rotated to the vertical axis.
+        Moebius look = hy_look_at(a);
+        real h = mo_apply(look, a).z;
+        Moebius face = mo_chain(mo_inverse(look), hy_zshift((real)0.5*log(h)));
+
+        ObjectGeometry *f = &group->faces[k];
+        f->type = OBJECT_HYPLANE;
+        f->map = face;
+        f->inverse = mo_inverse(face);
+        f->group = -1;
+    }
+}
+
+Group group_new(const Moebius *generators, int count) {
+    Group group;
+    group.count = 0;
+    for (int i = 0; i < count; ++i) {
+        _group_add(&group, generators[i]);
+    }
+    _group_derive(&group);
+    return group;
+}
+
+bool group_prepare(Group *group) {
+    Moebius generators[GROUP_GENERATORS_MAX];
+    int n = group->count;
+    for (int i = 0; i < n; ++i) {
+        generators[i] = group->generators[i];
+    }
+    group->count = 0;
+    bool fit = true;
+    for (int i = 0; i < n; ++i) {
+        fit = _group_add(group, generators[i]) && fit;
+    }
+    _group_derive(group);
+    return fit;
+}
+
+
+#ifdef OPENCL_INTEROP
+
+HyRay group_reduce(
+    __global const GroupPk *group,
+    HyRay ray, Moebius *element
+) {
+    *element = mo_identity();
+    for (int i = 0; i < GROUP_MAX_STEPS; ++i) {
+        // The point is outside of the domain if it is closer
+        // to the image of *j* than to *j* itself.
+        quaternion p = ray.start;
+        real dj = q_abs2(p - QJ);
+        real dmin = (real)0;
+        int kmin = -1;
+        for (int k = 0; k < group->count; ++k) {
+            quaternion a = q_unpack(group->images[k]);
+            real d = q_abs2(p - a)/a.z - dj;
+            if (d < dmin) {
+                dmin = d;
+                kmin = k;
+            }
+        }
+        if (kmin < 0) {
+            break;
+        }
+        Moebius g = mo_unpack(group->generators[group->inverse[kmin]]);
+        ray = hyray_map(g, ray);
+        *element = mo_chain(*element, mo_unpack(group->generators[kmin]));
+    }
+    return ray;
+}
+
+real group_hit(
+    __global const GroupPk *group, const ObjectGeometry *base,
+    ObjectHit *cache, Rng *rng, PathInfo *path,
+    HyRay ray
+) {
+    Moebius element;
+    HyRay r = group_reduce(group, ray, &element);
+
+    PathInfo face_path = *path;
+    face_path.repeat = false;
+
+    real dist = (real)0;
+    // Face the ray has just crossed, it cannot be crossed again.
+    int entered = -1;
+    for (int i = 0; i < GROUP_MAX_STEPS; ++i) {
+        ObjectHit ocache;
+        PathInfo opath = *path;
+        // The copy the ray started from is in the first cell only.
+        if (i > 0) {
+            opath.repeat = false;
+        }
+        real lo = object_hit(base, &ocache, rng, &opath, r);
+
+        // Faces are compared by the cosine of the distance,
+        // and only the nearest one is completed.
+        ObjectGeometry face;
+        ObjectHit fcache;
+        HyRay flocal;
+        real xf = (real)0, lf = (real)(-1);
+        int kf = -1;
+        for (int k = 0; k < group->count; ++k) {
+            if (k == entered) {
+                continue;
+            }
+            ObjectGeometry f;
+            f.type = OBJECT_HYPLANE;
+            f.map = mo_unpack(group->faces[k]);
+            f.inverse = mo_unpack(group->face_inverses[k]);
+            f.group = -1;
+            ObjectHit c;
+            HyRay local;
+            real x = object_hit_cosh(&f, &c, rng, &face_path, r, xf, &local);
+            if (x < (real)0) {
+                continue;
+            }
+            real l = hy_acosh(x);
+            if (l > EPS) {
+                xf = x;
+                lf = l;
+                kf = k;
+                face = f;
+                fcache = c;
+                flocal = local;
+            }
+        }
+        if (kf >= 0) {
+            object_hit_complete(&fcache, flocal);
+        }
+
+        if (lo > (real)0 && (kf < 0 || lo <= lf)) {
+            *cache = ocache;
+            cache->element = element;
+            *path = opath;
+            return dist + lo;
+        }
+        if (kf < 0) {
+            break;
+        }
+
+        // Continue from the face in the neighbouring cell
+        // mapped back to the domain.
+        HyRay e;
+        e.start = fcache.pos;
+        e.direction = fcache.dir;
+        e = hyray_map(face.map, e);
+        int inv = group->inverse[kf];
+        r = hyray_map(mo_unpack(group->generators[inv]), e);
+        element = mo_chain(element, mo_unpack(group->generators[kf]));
+        entered = inv;
+        dist += lf;
+    }
+    return (real)(-1);
+}
+
+void pack_group(GroupPk *dst, const Group *src) {
+    dst->count = src->count;
+    for (int k = 0; k < GROUP_GENERATORS_MAX; ++k) {
+        if (k < src->count) {
+            dst->inverse[k] = src->inverse[k];
+            dst->images[k] = q_pack(src->images[k]);
+            dst->generators[k] = mo_pack(src->generators[k]);
+            dst->faces[k] = mo_pack(src->faces[k].map);
+            dst->face_inverses[k] = mo_pack(src->faces[k].inverse);
+        } else {
+            dst->inverse[k] = -1;
+            dst->images[k] = q_pack(QJ);
+            dst->generators[k] = mo_pack(mo_identity());
+            dst->faces[k] = mo_pack(mo_identity());
+            dst->face_inverses[k] = mo_pack(mo_identity());
+        }
+    }
+}
+
+#endif // OPENCL_INTEROP
+
+
+#ifdef UNIT_TEST
+#include <catch.hpp>
+
+TEST_CASE("Symmetry groups", "[group]") {
+    TestRng rng;
+
+    SECTION("Faces are bisectors") {
+        for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+            Moebius g = random_moebius(rng);
+            Group group = group_new(&g, 1);
+            REQUIRE(group.count == 2);
+            REQUIRE(group.inverse[0] == 1);
+            for (int k = 0; k < group.count; ++k) {
+                for (int j = 0; j < TEST_ATTEMPTS; ++j) {
+                    complex u = rand_c_unit(rng);
+                    real z = rng.uniform();
+                    quaternion p = mo_apply(group.faces[k].map, q_new(sqrt(1 - z*z)*u, z, 0));
+                    REQUIRE(hy_distance(p, QJ) == Approx(hy_distance(p, group.images[k])));
+                }
+            }
+        }
+    }
+
+    SECTION("Generators are closed under inversion") {
+        Moebius gs[GROUP_GENERATORS_MAX];
+        for (int i = 0; i < GROUP_GENERATORS_MAX; ++i) {
+            gs[i] = random_moebius(rng);
+        }
+        Group group = group_new(gs, GROUP_GENERATORS_MAX);
+        REQUIRE(group.count == GROUP_GENERATORS_MAX);
+        for (int k = 0; k < group.count; ++k) {
+            int inv = group.inverse[k];
+            REQUIRE(inv >= 0);
+            REQUIRE(inv < group.count);
+            REQUIRE(group.inverse[inv] == k);
+            REQUIRE(mo_diff(mo_chain(group.generators[k], group.generators[inv]), mo_identity()) < 1e-8);
+        }
+
+        // Only the first half fits together with the inverses.
+        Group raw;
+        raw.count = GROUP_GENERATORS_MAX;
+        for (int i = 0; i < GROUP_GENERATORS_MAX; ++i) {
+            raw.generators[i] = gs[i];
+        }
+        REQUIRE(!group_prepare(&raw));
+        REQUIRE(raw.count == GROUP_GENERATORS_MAX);
+        for (int k = 0; k < raw.count; ++k) {
+            REQUIRE(mo_diff(raw.generators[k], group.generators[k]) < 1e-8);
+            REQUIRE(raw.inverse[k] == group.inverse[k]);
+        }
+    }
+
+#ifdef OPENCL_INTEROP
+    // Copies of the unit hyperbolic plane along the vertical axis,
+    // the domain is the shell between the faces at `exp(-d/2)` and `exp(d/2)`.
+    const real d = (real)1;
+    const Moebius shift = hy_zshift(d);
+    const Group group = group_new(&shift, 1);
+    GroupPk group_pk;
+    pack_group(&group_pk, &group);
+
+    ObjectGeometry base;
+    base.type = OBJECT_HYPLANE;
+    base.map = mo_identity();
+    base.inverse = mo_identity();
+    base.group = -1;
+
+    const auto random_ray = [&]() {
+        HyRay ray;
+        ray.start = q_new(rand_c_normal(rng), exp(4*rng.uniform() - 2), 0);
+        ray.direction = normalize(rand_q_normal(rng)*q_new(1, 1, 1, 0));
+        return ray;
+    };
+
+    SECTION("Reducing to the domain") {
+        for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+            HyRay ray = random_ray();
+            Moebius element;
+            HyRay r = group_reduce(&group_pk, ray, &element);
+            // Packed images are in single precision.
+            for (int k = 0; k < group.count; ++k) {
+                REQUIRE(hy_distance(r.start, QJ) <= hy_distance(r.start, group.images[k]) + 1e-4);
+            }
+            REQUIRE(length(mo_apply(element, r.start) - ray.start) == Approx(0).margin(1e-4*length(ray.start)));
+        }
+    }
+
+    SECTION("Hitting the copies") {
+        for (int i = 0; i < 16*TEST_ATTEMPTS; ++i) {
+            HyRay ray = random_ray();
+
+            // The nearest of the explicitly placed copies.
+            real dist = (real)(-1);
+            quaternion pos = QJ;
+            for (int k = -GROUP_MAX_STEPS; k <= GROUP_MAX_STEPS; ++k) {
+                ObjectGeometry copy = base;
+                copy.map = hy_zshift(k*d);
+                copy.inverse = mo_inverse(copy.map);
+                ObjectHit cache;
+                PathInfo path = {false, false, false};
+                real l = object_hit(&copy, &cache, nullptr, &path, ray);
+                if (l > (real)0 && (dist < (real)0 || l < dist)) {
+                    dist = l;
+                    pos = mo_apply(copy.map, cache.pos);
+                }
+            }
+
+            ObjectHit cache;
+            PathInfo path = {false, false, false};
+            real l = group_hit(&group_pk, &base, &cache, nullptr, &path, ray);
+            if (dist < (real)0) {
+                REQUIRE(l < (real)0);
+                continue;
+            }
+            REQUIRE(l == Approx(dist).epsilon(1e-3));
+            REQUIRE(hy_distance(mo_apply(cache.element, cache.pos), pos) < 1e-3);
+        }
+    }
+#endif // OPENCL_INTEROP
+};
+#endif // UNIT_TEST
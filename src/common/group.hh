@@ -0,0 +1,91 @@
+#pragma once
+
+#include <types.hh>
+#include <random.hh>
+#include <path.hh>
+
+#include <algebra/real.hh>
+#include <algebra/quaternion.hh>
+#include <algebra/moebius.hh>
+#include <geometry/hyperbolic/ray.hh>
+
+#include <object.hh>
+
+
+// Discrete groups of isometries generating copies of an object.
+//
+// Instead of storing every copy the scene stores the single base object
+// and the generators of the group. The generators are the face pairings
+// of the Dirichlet domain centered at *j*: the face of the `k`-th generator
+// is the bisector of *j* and its image `g_k(j)`, and the generator maps
+// the domain to the neighbouring cell across that face. The ray is traced
+// through the cells of the domain one by one, and in every cell it is
+// mapped back to the domain and tested against the base object only.
+// The base object must lie inside the domain, its parts outside are clipped.
+
+// Generators including the inverses appended by `group_prepare`.
+#define GROUP_GENERATORS_MAX 8
+// Cells the ray can pass before it is considered missed.
+#define GROUP_MAX_STEPS 32
+// Whether the scene has repeated instances, see `SCENE_OBJECT_TYPES`.
+#ifndef SCENE_GROUPS
+#define SCENE_GROUPS 1
+#endif // SCENE_GROUPS
+
+typedef struct {
+    int count;
+    Moebius generators[GROUP_GENERATORS_MAX];
+    // Derived by `group_prepare`.
+    // Index of the inverse generator.
+    int inverse[GROUP_GENERATORS_MAX];
+    // Images of *j*, the centers of the neighbouring cells.
+    quaternion images[GROUP_GENERATORS_MAX];
+    // Faces of the domain as hyperbolic planes.
+    ObjectGeometry faces[GROUP_GENERATORS_MAX];
+} Group;
+
+
+#ifdef OPENCL_INTEROP
+
+typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
+    int_pk count;
+    int_pk inverse[GROUP_GENERATORS_MAX];
+    quaternion_pk images[GROUP_GENERATORS_MAX];
+    MoebiusPk generators[GROUP_GENERATORS_MAX];
+    MoebiusPk faces[GROUP_GENERATORS_MAX];
+    MoebiusPk face_inverses[GROUP_GENERATORS_MAX];
+} GroupPk;
+
+#endif // OPENCL_INTEROP
+
+
+// Group with the given generators, the inverses are added
+// unless they are already among them. Derived fields are computed too.
+// A generator which doesn't fit together with its inverse is left out,
+// so every face of the domain has the paired one. The caller must check
+// `count` if the generators may not fit, see `group_prepare`.
+Group group_new(const Moebius *generators, int count);
+// Returns false if some generators are left out.
+bool group_prepare(Group *group);
+
+#ifdef OPENCL_INTEROP
+
+// Maps the ray start to the domain, `element` is set to the map
+// from the domain back to the original position.
+HyRay group_reduce(
+    __global const GroupPk *group,
+    HyRay ray, Moebius *element
+);
+
+// Casts the ray to all copies of the `base` object.
+// The copy that was hit is stored in the `cache` as the group element.
+real group_hit(
+    __global const GroupPk *group, const ObjectGeometry *base,
+    ObjectHit *cache, Rng *rng, PathInfo *path,
+    HyRay ray
+);
+
+void pack_group(GroupPk *dst, const Group *src);
+#define group_pack pack_group
+
+#endif // OPENCL_INTEROP
@@ -4,31 +4,82 @@
 #include <geometry/hyperbolic/horosphere.hh>
 
 
+ObjectGeometry object_geometry(const Object *object) {
+    ObjectGeometry g;
+    g.type = object->type;
+    g.map = object->map;
+    g.inverse = mo_inverse(object->map);
+    g.group = -1;
+    return g;
+}
+
+ObjectPrototype object_prototype(const Object *object) {
+    ObjectPrototype p;
+    for (int i = 0; i < MATERIAL_COUNT_MAX; ++i) {
+        p.materials[i] = object->materials[i];
+    }
+    p.material_count = object->material_count;
+    p.tiling = object->tiling;
+    return p;
+}
+
+ObjectInstance object_instance(const Object *object, int prototype) {
+    ObjectInstance n;
+    n.type = object->type;
+    n.map = object->map;
+    n.prototype = prototype;
+    n.group = -1;
+    return n;
+}
+
 real object_hit(
-    const Object *object, ObjectHit *cache,
+    const ObjectGeometry *geometry, ObjectHit *cache,
     Rng *rng, PathInfo *path,
     HyRay ray
 ) {
-    HyRay r = hyray_map(mo_inverse(object->map), ray);
+    HyRay local;
+    real x = object_hit_cosh(geometry, cache, rng, path, ray, (real)0, &local);
+    if (x < (real)0) {
+        return (real)(-1);
+    }
+    object_hit_complete(cache, local);
+    return hy_acosh(x);
+}
+
+real object_hit_cosh(
+    const ObjectGeometry *geometry, ObjectHit *cache,
+    Rng *rng, PathInfo *path,
+    HyRay ray, real bound, HyRay *local
+) {
+    HyRay r = hyray_map(geometry->inverse, ray);
 
     bool h = false;
-    if (object->type == OBJECT_HYPLANE) {
+    if (OBJECT_ENABLED(OBJECT_HYPLANE) && geometry->type == OBJECT_HYPLANE) {
         h = hyplane_hit(
-            object, cache,
+            geometry, cache,
             path, r
         );
-    } else if (object->type == OBJECT_HOROSPHERE) {
+    } else if (OBJECT_ENABLED(OBJECT_HOROSPHERE) && geometry->type == OBJECT_HOROSPHERE) {
         h = horosphere_hit(
-            object, cache,
+            geometry, cache,
             path, r
         );
     }
 
-    if (h) {
-        return hy_distance(cache->pos, r.start);
-    } else {
+    if (!h) {
+        return (real)(-1);
+    }
+    real x = hy_cosh_distance(cache->pos, r.start);
+    if (bound > (real)0 && x >= bound) {
         return (real)(-1);
     }
+    *local = r;
+    return x;
+}
+
+void object_hit_complete(ObjectHit *cache, HyRay local) {
+    cache->dir = hy_dir_at(local.start, local.direction, cache->pos);
+    cache->element = mo_identity();
 }
 
 bool object_bounce(
@@ -40,13 +91,13 @@ bool object_bounce(
     Material material;
     quaternion hit_dir, normal;
     
-    if (object->type == OBJECT_HYPLANE) {
+    if (OBJECT_ENABLED(OBJECT_HYPLANE) && object->type == OBJECT_HYPLANE) {
         hyplane_bounce(
             object, cache,
             &hit_dir, &normal,
             &material
         );
-    } else if (object->type == OBJECT_HOROSPHERE) {
+    } else if (OBJECT_ENABLED(OBJECT_HOROSPHERE) && object->type == OBJECT_HOROSPHERE) {
         horosphere_bounce(
             object, cache,
             &hit_dir, &normal,
@@ -65,21 +116,21 @@ bool object_bounce(
     ray->start = cache->pos;
     ray->direction = q_new(bounce_dir, (real)0);
 
-    *ray = hyray_map(object->map, *ray);
+    *ray = hyray_map(mo_chain(cache->element, object->map), *ray);
 
     return true;
 }
 
-void object_interpolate(
+void object_shading_interpolate(
     Object *o,
     const Object *a, const Object *b,
     real t
 ) {
     o->type = b->type;
-    o->map = mo_interpolate(a->map, b->map, t);
+    o->map = b->map;
 
     o->material_count = b->material_count;
-    for (int i = 0; i < MATERIAL_COUNT_MAX; ++i) {
+    for (int i = 0; i < SCENE_MATERIAL_COUNT; ++i) {
         material_interpolate(
             &o->materials[i],
             &a->materials[i], &b->materials[i],
@@ -90,12 +141,26 @@ void object_interpolate(
     tiling_interpolate(&o->tiling, &a->tiling, &b->tiling, t);
 }
 
+void object_geometry_interpolate(
+    ObjectGeometry *o, const ObjectGeometry *b,
+    const MoebiusPath *motion, real t
+) {
+    o->type = b->type;
+    o->map = mo_path_at(motion, t);
+    o->inverse = mo_inverse(o->map);
+    o->group = b->group;
+}
+
 void tiling_interpolate(
     Tiling *o,
     const Tiling *a, const Tiling *b,
     real t
 ) {
     o->type = b->type;
+    o->p = b->p;
+    o->q = b->q;
+    o->edge = b->edge;
+    o->rotation = b->rotation;
     INTERPOLATE_FIELD(*o, *a, *b, cell_size, t);
     INTERPOLATE_FIELD(*o, *a, *b, border_width, t);
     material_interpolate(
@@ -105,12 +170,29 @@ void tiling_interpolate(
     );
 }
 
+void tiling_prepare(Tiling *tiling) {
+    tiling->edge = (real)0;
+    tiling->rotation = C1;
+    if (tiling->type == HYPLANE_TILING_REGULAR) {
+        tiling->edge = regular_tiling_edge(tiling->p, tiling->q);
+        real o = 2*PI/tiling->p;
+        tiling->rotation = c_new(cos(o), sin(o));
+    } else if (tiling->type == HYPLANE_TILING_APEIROGONAL) {
+        tiling->edge = apeirogonal_tiling_height(tiling->q);
+    }
+}
+
 #ifdef OPENCL_INTEROP
 
-void pack_object(ObjectPk *dst, const Object *src) {
+void pack_object_instance(ObjectGeometryPk *dst, const ObjectInstance *src) {
     dst->type = src->type;
     dst->map = mo_pack(src->map);
+    dst->inverse = mo_pack(mo_inverse(src->map));
+    dst->prototype = src->prototype;
+    dst->group = src->group;
+}
 
+void pack_object_prototype(ObjectShadingPk *dst, const ObjectPrototype *src) {
     for (int i = 0; i < MATERIAL_COUNT_MAX; ++i) {
         pack_material(&dst->materials[i], &src->materials[i]);
     }
@@ -119,20 +201,37 @@ void pack_object(ObjectPk *dst, const Object *src) {
     pack_tiling(&dst->tiling, &src->tiling);
 }
 
-void unpack_object(Object *dst, const ObjectPk *src) {
-    dst->type = (ObjectType)src->type;
-    dst->map = mo_unpack(src->map);
+void unpack_object(
+    Object *dst,
+    const ObjectGeometryPk *src_geometry, const ObjectShadingPk *src_shading
+) {
+    dst->type = (ObjectType)src_geometry->type;
+    dst->map = mo_unpack(src_geometry->map);
 
-    for (int i = 0; i < MATERIAL_COUNT_MAX; ++i) {
-        unpack_material(&dst->materials[i], &src->materials[i]);
+    for (int i = 0; i < SCENE_MATERIAL_COUNT; ++i) {
+        unpack_material(&dst->materials[i], &src_shading->materials[i]);
     }
-    dst->material_count = (int)src->material_count;
+    dst->material_count = (int)src_shading->material_count;
 
-    unpack_tiling(&dst->tiling, &src->tiling);
+    unpack_tiling(&dst->tiling, &src_shading->tiling);
+}
+
+void unpack_object_geometry(ObjectGeometry *dst, const ObjectGeometryPk *src) {
+    dst->type = (ObjectType)src->type;
+    dst->map = mo_unpack(src->map);
+    dst->inverse = mo_unpack(src->inverse);
+    dst->group = (int)src->group;
 }
 
 void pack_tiling(TilingPk *dst, const Tiling *src) {
+    Tiling prepared = *src;
+    tiling_prepare(&prepared);
+
     dst->type = (TilingTypePk)src->type;
+    dst->p = (uchar_pk)src->p;
+    dst->q = (uchar_pk)src->q;
+    dst->edge = (real_pk)prepared.edge;
+    dst->rotation = c_pack(prepared.rotation);
     dst->cell_size = (real_pk)src->cell_size;
 
     dst->border_width = (real_pk)src->border_width;
@@ -141,6 +240,10 @@ void pack_tiling(TilingPk *dst, const Tiling *src) {
 
 void unpack_tiling(Tiling *dst, const TilingPk *src) {
     dst->type = (TilingType)src->type;
+    dst->p = (int)src->p;
+    dst->q = (int)src->q;
+    dst->edge = (real)src->edge;
+    dst->rotation = c_unpack(src->rotation);
     dst->cell_size = (real)src->cell_size;
     
     dst->border_width = (real)src->border_width;
@@ -17,16 +17,33 @@ typedef uchar    ObjectType;
 #define OBJECT_HYPLANE    1
 #define OBJECT_HOROSPHERE 2
 
+// Bit mask of the object types the kernel handles. Scene specialization
+// (see `gen/scene.cl`) restricts it to the types present in the scene,
+// so the compiler removes the branches of the others.
+#ifndef SCENE_OBJECT_TYPES
+#define SCENE_OBJECT_TYPES 0xff
+#endif // SCENE_OBJECT_TYPES
+#define OBJECT_ENABLED(type) (((SCENE_OBJECT_TYPES) >> (type)) & 1)
+
 typedef uchar    TilingType;
 
 typedef struct {
     TilingType type;
+    // Schlafli symbol of the regular tilings, `p` is ignored for apeirogonal ones.
+    int p, q;
     real cell_size;
     real border_width;
     Material border_material;
+    // Constants derived from `{p,q}` by `tiling_prepare`.
+    real edge;
+    complex rotation;
 } Tiling;
 
 #define MATERIAL_COUNT_MAX 4
+// Materials unpacked and interpolated, the ones beyond are never used.
+#ifndef SCENE_MATERIAL_COUNT
+#define SCENE_MATERIAL_COUNT MATERIAL_COUNT_MAX
+#endif // SCENE_MATERIAL_COUNT
 
 typedef struct {
     ObjectType type;
@@ -36,9 +53,39 @@ typedef struct {
     Tiling tiling;
 } Object;
 
+// Instanced objects. The appearance is stored once in the prototype
+// and shared by all instances which refer to it by index.
+typedef struct {
+    Material materials[MATERIAL_COUNT_MAX];
+    int material_count;
+    Tiling tiling;
+} ObjectPrototype;
+
+// Instance with non-negative `group` is repeated by the group
+// with that index, see `group.hh`.
+typedef struct {
+    ObjectType type;
+    Moebius map;
+    int prototype;
+    int group;
+} ObjectInstance;
+
+// Part of the object needed to test intersection with it.
+// The inverse map is precomputed once per object.
+typedef struct {
+    ObjectType type;
+    Moebius map;
+    Moebius inverse;
+    int group;
+} ObjectGeometry;
+
+// `pos` and `dir` are in the object's own coordinates.
+// `element` is the group element mapping the copy that was hit
+// to the original object, it is identity for non-repeated objects.
 typedef struct {
     quaternion pos;
     quaternion dir;
+    Moebius element;
 } ObjectHit;
 
 
@@ -49,29 +96,61 @@ typedef uchar_pk TilingTypePk;
 
 typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
     TilingTypePk type;
+    uchar_pk p, q;
+    real_pk edge;
+    complex_pk rotation;
     real_pk cell_size;
     real_pk border_width;
     MaterialPk border_material _PACKED_FIELD_ATTRIBUTE_;
 } TilingPk;
 
+// Objects are stored in two buffers. The intersection loop reads
+// only the small geometry records (one per instance), and the shading
+// record (one per prototype) is read for the nearest hit only.
+
 // FIXME: Use explicit alignment instead of `packed` attribute
 // because it suppresses referencing of field of such structure.
 typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
     uint_pk type;
     MoebiusPk map;
+    MoebiusPk inverse;
+    int_pk prototype;
+    int_pk group;
+} ObjectGeometryPk;
+
+typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
     MaterialPk materials[MATERIAL_COUNT_MAX] _PACKED_FIELD_ATTRIBUTE_;
     int_pk material_count;
     TilingPk tiling _PACKED_FIELD_ATTRIBUTE_;
-} ObjectPk;
+} ObjectShadingPk;
 
 #endif // OPENCL_INTEROP
 
 
+ObjectGeometry object_geometry(const Object *object);
+// Splits the object into its own prototype and an instance of it.
+ObjectPrototype object_prototype(const Object *object);
+ObjectInstance object_instance(const Object *object, int prototype);
+
+// Casts the ray to the object and returns the distance to the hit
+// or a negative value if the object is missed.
 real object_hit(
-    const Object *object, ObjectHit *cache,
+    const ObjectGeometry *geometry, ObjectHit *cache,
     Rng *rng, PathInfo *path,
     HyRay ray
 );
+// The cheap part of `object_hit` to find the nearest of many objects.
+// Returns the hyperbolic cosine of the distance to the hit or a negative
+// value if the object is missed or the hit is not nearer than `bound`
+// (also a cosine, non-positive for no bound). Only the position of the hit
+// is stored, the rest is done by `object_hit_complete` for the nearest hit
+// with the ray in the object coordinates stored to `local`.
+real object_hit_cosh(
+    const ObjectGeometry *geometry, ObjectHit *cache,
+    Rng *rng, PathInfo *path,
+    HyRay ray, real bound, HyRay *local
+);
+void object_hit_complete(ObjectHit *cache, HyRay local);
 
 bool object_bounce(
     const Object *object, const ObjectHit *cache,
@@ -80,23 +159,37 @@ bool object_bounce(
     float3 *light, float3 *emission
 );
 
-void object_interpolate(
+// Interpolates the materials and the tiling, the map is the one of `b`.
+// The map of a moving object is taken from its motion instead.
+void object_shading_interpolate(
     Object *o,
     const Object *a, const Object *b,
     real t
 );
+// The map is taken at `t` along the `motion` precomputed
+// from the previous map to the map of `b`.
+void object_geometry_interpolate(
+    ObjectGeometry *o, const ObjectGeometry *b,
+    const MoebiusPath *motion, real t
+);
 void tiling_interpolate(
     Tiling *o,
     const Tiling *a, const Tiling *b,
     real t
 );
+// Computes the derived constants, it is done once when the tiling is packed.
+void tiling_prepare(Tiling *tiling);
 
 #ifdef OPENCL_INTEROP
-void pack_object(ObjectPk *dst, const Object *src);
-void unpack_object(Object *dst, const ObjectPk *src);
+void pack_object_instance(ObjectGeometryPk *dst, const ObjectInstance *src);
+void pack_object_prototype(ObjectShadingPk *dst, const ObjectPrototype *src);
+void unpack_object(
+    Object *dst,
+    const ObjectGeometryPk *src_geometry, const ObjectShadingPk *src_shading
+);
+void unpack_object_geometry(ObjectGeometry *dst, const ObjectGeometryPk *src);
 void pack_tiling(TilingPk *dst, const Tiling *src);
 void unpack_tiling(Tiling *dst, const TilingPk *src);
-#define object_pack pack_object
 #define object_unpack unpack_object
 #define tiling_pack pack_tiling
 #define tiling_unpack unpack_tiling
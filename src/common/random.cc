@@ -1,43 +1,194 @@
 #include "random.hh"
 
 
-void rand_init(Rng *rng, uint seed) {
-    rng->state = seed;
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+uint _mul_hi(uint a, uint b) {
+#ifdef OPENCL
+    return mul_hi(a, b);
+#else // OPENCL
+    return (uint)(((uint64_t)a*(uint64_t)b) >> 32);
+#endif // OPENCL
+}
+
+void philox4x32(const uint counter[4], const uint key[2], uint out[4]) {
+    uint c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint k0 = key[0], k1 = key[1];
+    for (int i = 0; i < 10; ++i) {
+        uint hi0 = _mul_hi(PHILOX_M0, c0), lo0 = PHILOX_M0*c0;
+        uint hi1 = _mul_hi(PHILOX_M1, c2), lo1 = PHILOX_M1*c2;
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+uint _hash_uint(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint _reverse_bits(uint x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// Hash-based Owen scrambling (Laine-Karras permutation applied
+// to the reversed bits), see Burley, "Practical Hash-based Owen Scrambling".
+uint _owen_scramble(uint x, uint seed) {
+    x = _reverse_bits(x);
+    x += seed;
+    x ^= x*0x6c50b47cu;
+    x ^= x*0xb82f1e52u;
+    x ^= x*0xc7afe638u;
+    x ^= x*0x8d22f6e6u;
+    return _reverse_bits(x);
+}
+
+// Second dimension of Sobol sequence, the first one is the bit reversal.
+uint _sobol1(uint index) {
+    uint r = 0;
+    for (uint v = 0x80000000u; index != 0; index >>= 1, v ^= v >> 1) {
+        if (index & 1) {
+            r ^= v;
+        }
+    }
+    return r;
+}
+
+real _uint_to_uniform(uint x) {
+    // Only 24 bits are used to never round up to 1 in single precision.
+    return (x >> 8)/(real)0x1000000;
+}
+
+real2 sobol_owen2(uint index, uint seed) {
+    uint i = _owen_scramble(index, _hash_uint(seed));
+    uint x = _owen_scramble(_reverse_bits(i), _hash_uint(seed ^ 0x5bd1e995u));
+    uint y = _owen_scramble(_sobol1(i), _hash_uint(seed ^ 0x1b873593u));
+    return make_real2(_uint_to_uniform(x), _uint_to_uniform(y));
+}
+
+
+void rand_init(Rng *rng, uint index, uint frame, uint sample, uint stream, bool low_discrepancy) {
+    rng->key[0] = index;
+    rng->key[1] = 0x6a09e667u ^ _hash_uint(frame);
+    rng->counter[0] = sample;
+    rng->counter[1] = stream;
+    rng->counter[2] = 0;
+    rng->counter[3] = 0;
+    rng->used = 4;
+    rng->dim = 0;
+    rng->low_discrepancy = low_discrepancy;
 }
 
 uint rand_int(Rng *rng) {
-    return (rng->state = 1103515245*rng->state + 12345);
+    if (rng->used >= 4) {
+        philox4x32(rng->counter, rng->key, rng->buffer);
+        rng->counter[2] += 1;
+        rng->used = 0;
+    }
+    uint x = rng->buffer[rng->used];
+    rng->used += 1;
+    return x;
 }
 
 real rand_uniform(Rng *rng) {
-    return rand_int(rng)/(real)0x100000000;
+    return _uint_to_uniform(rand_int(rng));
+}
+
+real2 rand_uniform2(Rng *rng) {
+    if (rng->low_discrepancy) {
+        // The same dimension of all samples of the pixel
+        // forms a single scrambled sequence.
+        uint seed = _hash_uint(rng->key[0] ^ _hash_uint(rng->key[1] ^ _hash_uint(rng->counter[1] ^ _hash_uint(rng->dim))));
+        rng->dim += 1;
+        return sobol_owen2(rng->counter[0], seed);
+    }
+    real x = rand_uniform(rng);
+    return make_real2(x, rand_uniform(rng));
 }
 
 real3 rand_sphere(Rng *rng) {
-    float phi = (real)2*PI*rand_uniform(rng);
-    float cos_theta = (real)1 - (real)2*rand_uniform(rng);
+    real2 u = rand_uniform2(rng);
+    float phi = (real)2*PI*u.x;
+    float cos_theta = (real)1 - (real)2*u.y;
     float sin_theta = sqrt((real)1 - cos_theta*cos_theta);
     return make_real3(cos(phi)*sin_theta, sin(phi)*sin_theta, cos_theta);
 }
 
 real3 rand_hemisphere(Rng *rng) {
-    float phi = (real)2*PI*rand_uniform(rng);
-    float cos_theta = rand_uniform(rng);
+    real2 u = rand_uniform2(rng);
+    float phi = (real)2*PI*u.x;
+    float cos_theta = u.y;
     float sin_theta = sqrt((real)1 - cos_theta*cos_theta);
     return make_real3(cos(phi)*sin_theta, sin(phi)*sin_theta, cos_theta);
 }
 
 real3 rand_hemisphere_cosine(Rng *rng) {
-    float phi = (real)2*PI*rand_uniform(rng);
-    float sqr_cos_theta = rand_uniform(rng);
+    real2 u = rand_uniform2(rng);
+    float phi = (real)2*PI*u.x;
+    float sqr_cos_theta = u.y;
     float cos_theta = sqrt(sqr_cos_theta);
     float sin_theta = sqrt((real)1 - sqr_cos_theta);
     return make_real3(cos(phi)*sin_theta, sin(phi)*sin_theta, cos_theta);
 }
 
 real3 rand_sphere_cap(Rng *rng, float cos_alpha) {
-    float phi = (real)2*PI*rand_uniform(rng);
-    float cos_theta = (real)1 - ((real)1 - cos_alpha)*rand_uniform(rng);
+    real2 u = rand_uniform2(rng);
+    float phi = (real)2*PI*u.x;
+    float cos_theta = (real)1 - ((real)1 - cos_alpha)*u.y;
     float sin_theta = sqrt((real)1 - cos_theta*cos_theta);
     return make_real3(cos(phi)*sin_theta, sin(phi)*sin_theta, cos_theta);
 }
+
+
+#ifdef UNIT_TEST
+#include <catch.hpp>
+
+TEST_CASE("Random numbers", "[random]") {
+    SECTION("Philox known answers") {
+        const uint counter[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+        const uint key[2] = {0xa4093822, 0x299f31d0};
+        const uint expected[4] = {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+        uint out[4];
+        philox4x32(counter, key, out);
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(out[i] == expected[i]);
+        }
+    }
+
+    SECTION("Sobol points are stratified") {
+        for (uint seed = 0; seed < 16; ++seed) {
+            // Every elementary interval of 16 points contains one point.
+            for (int nx = 1; nx <= 16; nx *= 2) {
+                int ny = 16/nx;
+                int cells[16] = {0};
+                for (uint i = 0; i < 16; ++i) {
+                    real2 p = sobol_owen2(i, seed);
+                    REQUIRE(p.x >= 0); REQUIRE(p.x < 1);
+                    REQUIRE(p.y >= 0); REQUIRE(p.y < 1);
+                    cells[(int)(p.x*nx) + nx*(int)(p.y*ny)] += 1;
+                }
+                for (int c = 0; c < 16; ++c) {
+                    REQUIRE(cells[c] == 1);
+                }
+            }
+        }
+    }
+};
+#endif // UNIT_TEST
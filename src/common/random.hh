@@ -4,15 +4,37 @@
 #include <algebra/real.hh>
 
 
+// Stateless counter-based generator (Philox4x32-10).
+// Numbers are a pure function of the pixel index, the frame, the sample
+// number, the stream and the position in the stream, so nothing has to be
+// stored between launches.
 typedef struct Rng {
-    uint state;
+    uint key[2];
+    uint counter[4];
+    uint buffer[4];
+    int used;
+    // Index of the next 2D low-discrepancy dimension.
+    uint dim;
+    bool low_discrepancy;
 } Rng;
 
 
-void rand_init(Rng *rng, uint seed);
+// `frame` changes with every fresh image, so the successive frames of an
+// animation don't repeat the same noise. `stream` separates the numbers
+// drawn for the same sample by different kernels (e.g. path depth
+// in wavefront mode).
+void rand_init(Rng *rng, uint index, uint frame, uint sample, uint stream, bool low_discrepancy);
+
+void philox4x32(const uint counter[4], const uint key[2], uint out[4]);
+
+// Owen-scrambled Sobol (0,2)-sequence point with seeds derived from `seed`.
+real2 sobol_owen2(uint index, uint seed);
 
 uint rand_int(Rng *rng);
 real rand_uniform(Rng *rng);
+// Pair of uniform numbers. It is stratified over the samples
+// of the pixel if `low_discrepancy` is set.
+real2 rand_uniform2(Rng *rng);
 real3 rand_sphere(Rng *rng);
 real3 rand_hemisphere(Rng *rng);
 real3 rand_hemisphere_cosine(Rng *rng);
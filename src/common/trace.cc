@@ -0,0 +1,273 @@
+#include "trace.hh"
+
+
+#ifdef OPENCL_INTEROP
+
+int motion_segment(int segments, real time, real *t) {
+    real s = time*segments;
+    int k = (int)s;
+    // The time can be exactly at the end of the shutter.
+    if (k > segments - 1) {
+        k = segments - 1;
+    }
+    *t = s - (real)k;
+    return k;
+}
+
+void scene_get_geometry(
+    const Scene *scene, ObjectGeometry *geom,
+    int i, real time, bool interpolate
+) {
+    ObjectGeometryPk geom_pk = scene->geometry[i];
+    if (interpolate && scene->objects_mask[i] != 0) {
+        real t;
+        int k = motion_segment(scene->motion_segments, time, &t);
+        MoebiusPath motion = mo_path_unpack(scene->motion[i*scene->motion_segments + k]);
+        ObjectGeometry geom_orig;
+        unpack_object_geometry(&geom_orig, &geom_pk);
+        object_geometry_interpolate(geom, &geom_orig, &motion, t);
+    } else {
+        unpack_object_geometry(geom, &geom_pk);
+    }
+}
+
+void scene_get_object(
+    const Scene *scene, Object *obj,
+    int i, real time, bool interpolate
+) {
+    ObjectGeometryPk geom_pk = scene->geometry[i];
+    int proto = geom_pk.prototype;
+    ObjectShadingPk shad_pk = scene->shading[proto];
+    if (interpolate && scene->objects_mask[i] != 0) {
+        // The shading is interpolated over the whole shutter
+        // from the first keyframe, the map along its segment.
+        ObjectShadingPk shad_prev_pk = scene->shading_prev[proto];
+        Object obj_orig, obj_prev;
+        unpack_object(&obj_orig, &geom_pk, &shad_pk);
+        unpack_object(&obj_prev, &geom_pk, &shad_prev_pk);
+        object_shading_interpolate(obj, &obj_prev, &obj_orig, time);
+        real t;
+        int k = motion_segment(scene->motion_segments, time, &t);
+        MoebiusPath motion = mo_path_unpack(scene->motion[i*scene->motion_segments + k]);
+        obj->map = mo_path_at(&motion, t);
+    } else {
+        unpack_object(obj, &geom_pk, &shad_pk);
+    }
+}
+
+void scene_hit_object(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    HyRay ray, int prev, PathInfo path,
+    int i, SceneHit *nearest
+) {
+    ObjectGeometry geom;
+    scene_get_geometry(scene, &geom, i, time, config->object_motion_blur);
+    scene_hit_geometry(scene, rng, ray, prev, path, i, &geom, nearest);
+}
+
+void scene_hit_geometry(
+    const Scene *scene, Rng *rng,
+    HyRay ray, int prev, PathInfo path,
+    int i, const ObjectGeometry *geom, SceneHit *nearest
+) {
+    ObjectHit cache;
+    HyRay local = ray;
+    path.repeat = (prev == i);
+    // The objects farther than the nearest hit are culled early.
+    real bound = nearest->index >= 0 ? nearest->distance_cosh : (real)0;
+    real x;
+    bool complete = false;
+    if (SCENE_GROUPS && geom->group >= 0) {
+        real l = group_hit(&scene->groups[geom->group], geom, &cache, rng, &path, ray);
+        x = l > (real)0 ? cosh(l) : (real)(-1);
+        complete = true;
+    } else {
+        x = object_hit_cosh(geom, &cache, rng, &path, ray, bound, &local);
+    }
+    if (x > (real)1 && (x < nearest->distance_cosh || nearest->index < 0)) {
+        nearest->index = i;
+        nearest->distance_cosh = x;
+        nearest->hit = cache;
+        nearest->local = local;
+        nearest->complete = complete;
+        nearest->path = path;
+    }
+}
+
+int scene_hit(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    HyRay ray, int prev,
+    ObjectHit *hit, PathInfo *path
+) {
+    SceneHit nearest;
+    nearest.index = -1;
+    nearest.distance_cosh = (real)(-1);
+
+#ifdef SCENE_SPECIALIZED
+    SCENE_HIT_OBJECTS(scene, config, rng, time, ray, prev, *path, &nearest);
+#else // SCENE_SPECIALIZED
+    for (int j = 0; j < scene->bvh_unbounded_count; ++j) {
+        scene_hit_object(
+            scene, config, rng, time,
+            ray, prev, *path,
+            scene->bvh_indices[j], &nearest
+        );
+    }
+
+    if (scene->bvh_node_count > 0) {
+        BvhRay bray = bvh_ray_init(ray);
+        int n = 0;
+        while (n < scene->bvh_node_count) {
+            BvhNodePk node = scene->bvh_nodes[n];
+            real4 ball = unpack_real4(node.ball);
+            if (bvh_ball_hit(&bray, q_new(ball.xyz, R0), ball.w)) {
+                for (int j = node.first; j < node.first + node.count; ++j) {
+                    scene_hit_object(
+                        scene, config, rng, time,
+                        ray, prev, *path,
+                        scene->bvh_indices[j], &nearest
+                    );
+                }
+                n += 1;
+            } else {
+                n = node.skip;
+            }
+        }
+    }
+#endif // SCENE_SPECIALIZED
+
+    if (nearest.index >= 0) {
+        if (!nearest.complete) {
+            object_hit_complete(&nearest.hit, nearest.local);
+        }
+        *hit = nearest.hit;
+        *path = nearest.path;
+    }
+    return nearest.index;
+}
+
+void path_init(PathState *state, HyRay ray) {
+    state->ray = ray;
+    state->color = make_float3(0.0f);
+    state->light = make_float3(1.0f);
+
+    state->path.repeat = false;
+    state->path.face = false;
+    state->path.diffuse = false;
+
+    state->prev = -1;
+    state->diffuse = 0;
+}
+
+bool path_shade(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    PathState *state,
+    int index, ObjectHit *hit, PathInfo hpath
+) {
+    if (index < 0) {
+        state->color += state->light;
+        return false;
+    }
+
+    Object obj;
+    scene_get_object(scene, &obj, index, time, config->object_motion_blur);
+    if (!object_bounce(
+        &obj, hit,
+        rng, &hpath,
+        &state->ray,
+        &state->light, &state->color
+    )) {
+        return false;
+    }
+
+    state->prev = index;
+    state->path = hpath;
+    if (state->path.diffuse) {
+        if (state->diffuse >= config->path_max_diffuse_depth) {
+            return false;
+        }
+        state->diffuse += 1;
+    }
+    return true;
+}
+
+float3 trace_path(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    HyRay ray, int *ray_count, quaternion *first_hit
+) {
+    PathState state;
+    path_init(&state, ray);
+    if (first_hit != 0) {
+        *first_hit = q_new((real)0, (real)0, (real)0, (real)(-1));
+    }
+
+    for (int k = 0; k < config->path_max_depth; ++k) {
+        if (ray_count != 0) {
+            *ray_count += 1;
+        }
+        ObjectHit hit;
+        PathInfo hpath = state.path;
+        int mi = scene_hit(
+            scene, config, rng, time,
+            state.ray, state.prev,
+            &hit, &hpath
+        );
+        bool next = path_shade(scene, config, rng, time, &state, mi, &hit, hpath);
+        // The bounced ray starts from the hit in the scene coordinates.
+        if (k == 0 && mi >= 0 && first_hit != 0) {
+            *first_hit = state.ray.start;
+        }
+        if (!next) {
+            break;
+        }
+    }
+
+    return state.color;
+}
+
+HyRay trace_camera(
+    const TraceConfig *config,
+    Rng *rng, real *time,
+    View view, __global const ViewMotionPk *motion,
+    int2 pos, int2 size
+) {
+    *time = rand_uniform(rng);
+    if (config->motion_blur) {
+        real t;
+        int k = motion_segment(config->motion_segments, *time, &t);
+        ViewMotion m = view_motion_unpack(motion[k]);
+        view = view_motion_at(&m, t);
+    }
+
+    real2 jitter = rand_uniform2(rng);
+    quaternion v = q_new(
+        ((real)pos.x - (real)0.5*size.x + jitter.x)/size.y,
+        ((real)pos.y - (real)0.5*size.y + jitter.y)/size.y,
+        view.field_of_view, (real)0
+    );
+
+    HyRay ray = hyray_init();
+    ray.direction = v;
+    if (config->lens_blur) {
+        ray = draw_from_lens(rng, v, view.focal_length, view.lens_radius);
+    }
+    return hyray_map(view.position, ray);
+}
+
+float3 trace_sample(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng,
+    View view, __global const ViewMotionPk *motion,
+    int2 pos, int2 size,
+    int *ray_count, quaternion *first_hit
+) {
+    real time;
+    HyRay ray = trace_camera(config, rng, &time, view, motion, pos, size);
+    return trace_path(scene, config, rng, time, ray, ray_count, first_hit);
+}
+
+#endif // OPENCL_INTEROP
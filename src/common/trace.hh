@@ -0,0 +1,161 @@
+#pragma once
+
+#include <types.hh>
+#include <random.hh>
+#include <path.hh>
+
+#include <algebra/real.hh>
+#include <geometry/hyperbolic/ray.hh>
+
+#include <object.hh>
+#include <view.hh>
+#include <bvh.hh>
+#include <group.hh>
+
+
+// Settings of the path tracer.
+// On the device they are compile-time constants from `gen/config.cl`,
+// on the host they are taken from the renderer configuration at runtime.
+typedef struct {
+    int path_max_depth;
+    int path_max_diffuse_depth;
+    bool lens_blur;
+    bool motion_blur;
+    bool object_motion_blur;
+    // The motion during the shutter is interpolated piecewise
+    // between the keyframes evenly spaced in time, one more than segments.
+    int motion_segments;
+    // Draw the 2D dimensions from scrambled Sobol sequences.
+    bool low_discrepancy;
+} TraceConfig;
+
+#ifdef OPENCL_INTEROP
+
+// Objects of the scene as they are stored in the renderer buffers.
+// Geometry is per instance, shading is per prototype.
+typedef struct {
+    __global const ObjectGeometryPk *geometry;
+    // Paths of the moving instances between the keyframes,
+    // the segments of the `i`-th instance start at `i*motion_segments`.
+    __global const MoebiusPathPk *motion;
+    int motion_segments;
+    __global const ObjectShadingPk *shading;
+    __global const ObjectShadingPk *shading_prev;
+    __global const uchar_pk *objects_mask;
+    int object_count;
+
+    __global const BvhNodePk *bvh_nodes;
+    __global const int_pk *bvh_indices;
+    int bvh_node_count;
+    int bvh_unbounded_count;
+
+    // Groups repeating the instances with non-negative `group`.
+    __global const GroupPk *groups;
+} Scene;
+
+// The nearest hit found so far. The candidates are compared by
+// `object_hit_cosh`, and only the nearest one is completed at the end.
+typedef struct {
+    int index;
+    // Hyperbolic cosine of the distance.
+    real distance_cosh;
+    ObjectHit hit;
+    // The ray in the object coordinates to complete the hit with.
+    HyRay local;
+    // Hits of the repeated objects are completed at once.
+    bool complete;
+    PathInfo path;
+} SceneHit;
+
+// Segment of the piecewise motion the `time` of the shutter falls into,
+// `t` is set to the time within the segment.
+int motion_segment(int segments, real time, real *t);
+
+// Reads only the geometry of the `i`-th object, used for intersection.
+// If `interpolate` is set the moving objects are taken at `time`.
+void scene_get_geometry(
+    const Scene *scene, ObjectGeometry *geom,
+    int i, real time, bool interpolate
+);
+// Reads the whole `i`-th object, used for shading of the nearest hit.
+void scene_get_object(
+    const Scene *scene, Object *obj,
+    int i, real time, bool interpolate
+);
+
+// Casts the `ray` to the scene and returns the index of the nearest object
+// or `-1` if the ray hits nothing. `prev` is the index of the object
+// the ray starts from.
+// If the kernel is specialized to the scene, `SCENE_HIT_OBJECTS` from
+// `gen/scene.cl` tests every object in turn instead of traversing the BVH.
+// The types of the static objects are compiled into it as constants.
+int scene_hit(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    HyRay ray, int prev,
+    ObjectHit *hit, PathInfo *path
+);
+
+// Tests the `i`-th object and updates `nearest` if it is closer.
+void scene_hit_object(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    HyRay ray, int prev, PathInfo path,
+    int i, SceneHit *nearest
+);
+// The same for the `i`-th object with the given geometry.
+void scene_hit_geometry(
+    const Scene *scene, Rng *rng,
+    HyRay ray, int prev, PathInfo path,
+    int i, const ObjectGeometry *geom, SceneHit *nearest
+);
+
+// State of the path between bounces.
+typedef struct {
+    HyRay ray;
+    float3 color;
+    float3 light;
+    PathInfo path;
+    int prev;
+    int diffuse;
+} PathState;
+
+void path_init(PathState *state, HyRay ray);
+
+// Shades the hit of the `index`-th object found by `scene_hit`,
+// or the miss if `index` is negative. Returns whether the path continues.
+bool path_shade(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    PathState *state,
+    int index, ObjectHit *hit, PathInfo hpath
+);
+
+// Traces the path starting with `ray` and returns its color.
+// The number of rays cast is added to `ray_count` unless it is null.
+// The position of the first hit is stored to `first_hit` unless it is null,
+// its `w` is negative if the ray hits nothing.
+float3 trace_path(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng, real time,
+    HyRay ray, int *ray_count, quaternion *first_hit
+);
+
+// Draws the time and the primary ray of a sample of the pixel at `pos`.
+HyRay trace_camera(
+    const TraceConfig *config,
+    Rng *rng, real *time,
+    View view, __global const ViewMotionPk *motion,
+    int2 pos, int2 size
+);
+
+// Draws a single sample of the pixel at `pos` of the `size` image.
+float3 trace_sample(
+    const Scene *scene, const TraceConfig *config,
+    Rng *rng,
+    View view, __global const ViewMotionPk *motion,
+    int2 pos, int2 size,
+    int *ray_count, quaternion *first_hit
+);
+
+#endif // OPENCL_INTEROP
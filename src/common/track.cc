@@ -0,0 +1,79 @@
+#include "track.hh"
+
+
+#ifdef OPENCL_INTEROP
+
+int track_segment(__global const TrackKeyPk *keys, int count, real time, real *t) {
+    // The last key not after `time`, or the first one.
+    int lo = 0, hi = count;
+    while (hi - lo > 1) {
+        int mid = (lo + hi)/2;
+        if ((real)keys[mid].time <= time) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    *t = (real)0;
+    real t0 = (real)keys[lo].time;
+    if (lo + 1 < count && time > t0) {
+        *t = (time - t0)/((real)keys[lo + 1].time - t0);
+    }
+    return lo;
+}
+
+Moebius track_map(__global const TrackKeyPk *keys, int count, real time) {
+    real t;
+    int k = track_segment(keys, count, time, &t);
+    MoebiusPath path = mo_path_unpack(keys[k].path);
+    return mo_path_at(&path, t);
+}
+
+MoebiusPath track_path(__global const TrackKeyPk *keys, int count, real time0, real time1) {
+    real t0, t1;
+    int k0 = track_segment(keys, count, time0, &t0);
+    int k1 = track_segment(keys, count, time1, &t1);
+    // The end exactly at the next key is the end of the segment.
+    if (k1 == k0 + 1 && t1 == (real)0) {
+        k1 = k0;
+        t1 = (real)1;
+    }
+    if (k0 == k1) {
+        MoebiusPath path = mo_path_unpack(keys[k0].path);
+        return mo_path_sub(&path, t0, t1);
+    }
+    return mo_path_new(
+        track_map(keys, count, time0),
+        track_map(keys, count, time1)
+    );
+}
+
+void track_evaluate(
+    __global const TrackKeyPk *keys, int count, real time,
+    ObjectGeometryPk *geometry, ObjectShadingPk *shading
+) {
+    real t;
+    int k = track_segment(keys, count, time, &t);
+
+    ObjectGeometryPk geom_pk = keys[k].geometry;
+    ObjectShadingPk shad_pk = keys[k].shading;
+    Object obj;
+    unpack_object(&obj, &geom_pk, &shad_pk);
+    if (t > (real)0) {
+        ObjectGeometryPk next_geom_pk = keys[k + 1].geometry;
+        ObjectShadingPk next_shad_pk = keys[k + 1].shading;
+        Object start = obj, next;
+        unpack_object(&next, &next_geom_pk, &next_shad_pk);
+        object_shading_interpolate(&obj, &start, &next, t);
+    }
+    MoebiusPath path = mo_path_unpack(keys[k].path);
+    obj.map = mo_path_at(&path, t);
+
+    ObjectInstance inst = object_instance(&obj, geom_pk.prototype);
+    inst.group = geom_pk.group;
+    pack_object_instance(geometry, &inst);
+    ObjectPrototype proto = object_prototype(&obj);
+    pack_object_prototype(shading, &proto);
+}
+
+#endif // OPENCL_INTEROP
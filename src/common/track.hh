@@ -0,0 +1,52 @@
+#pragma once
+
+#include <types.hh>
+
+#include <algebra/real.hh>
+#include <algebra/moebius.hh>
+
+#include <object.hh>
+
+
+// Keyframed animation of objects stored on the device.
+//
+// The keys of all tracks are stored in a single buffer, and every frame
+// the tracks are evaluated at its time into the object buffers, so the host
+// doesn't rebuild and upload the objects. Between the keys the map moves
+// along the precomputed path and the shading changes linearly. Before
+// the first key and after the last one the object stays at them.
+
+#ifdef OPENCL_INTEROP
+
+typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
+    real_pk time;
+    ObjectGeometryPk geometry _PACKED_FIELD_ATTRIBUTE_;
+    ObjectShadingPk shading _PACKED_FIELD_ATTRIBUTE_;
+    // Path of the map to the next key, the last key stays in place.
+    MoebiusPathPk path _PACKED_FIELD_ATTRIBUTE_;
+} TrackKeyPk;
+
+// Keys `[first, first + count)` of the buffer.
+typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
+    int_pk first;
+    int_pk count;
+} TrackPk;
+
+// Key the `time` falls after, `t` is set to the time
+// from it to the next key from 0 to 1.
+int track_segment(__global const TrackKeyPk *keys, int count, real time, real *t);
+
+// Map of the track at `time`.
+Moebius track_map(__global const TrackKeyPk *keys, int count, real time);
+
+// Path of the map from `time0` to `time1`. It is a part of the precomputed
+// path if both are between the same keys, otherwise it's computed here.
+MoebiusPath track_path(__global const TrackKeyPk *keys, int count, real time0, real time1);
+
+// Object records of the track at `time`.
+void track_evaluate(
+    __global const TrackKeyPk *keys, int count, real time,
+    ObjectGeometryPk *geometry, ObjectShadingPk *shading
+);
+
+#endif // OPENCL_INTEROP
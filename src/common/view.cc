@@ -1,5 +1,7 @@
 #include "view.hh"
 
+#include <geometry/hyperbolic.hh>
+
 
 View view_init() {
     View v;
@@ -25,6 +27,68 @@ View view_interpolate(View a, View b, real t) {
     return o;
 }
 
+ViewMotion view_motion_new(View a, View b) {
+    ViewMotion m;
+    m.position = mo_path_new(a.position, b.position);
+    m.field_of_view[0] = a.field_of_view;
+    m.field_of_view[1] = b.field_of_view;
+    m.lens_radius[0] = a.lens_radius;
+    m.lens_radius[1] = b.lens_radius;
+    m.focal_length[0] = a.focal_length;
+    m.focal_length[1] = b.focal_length;
+    return m;
+}
+
+View view_motion_at(const ViewMotion *motion, real t) {
+    View o;
+    o.position = mo_path_at(&motion->position, t);
+    o.field_of_view = motion->field_of_view[0]*(1 - t) + motion->field_of_view[1]*t;
+    o.lens_radius = motion->lens_radius[0]*(1 - t) + motion->lens_radius[1]*t;
+    o.focal_length = motion->focal_length[0]*(1 - t) + motion->focal_length[1]*t;
+    return o;
+}
+
+HyRay draw_from_lens(
+    Rng *rng,
+    quaternion v,
+    real focal_length, real lens_radius
+) {
+    quaternion f = mo_apply(mo_chain(
+        mo_inverse(hy_look_to(v)),
+        hy_zshift(focal_length)
+    ), QJ);
+
+    // FIXME: Why usage of `lens_radius` cause
+    // assertion failure on Intel HD Graphics?
+    real2 u = rand_uniform2(rng);
+    real q = u.x*(cosh(lens_radius) - 1) + 1;
+    real r = log(q + sqrt(q*q - 1));
+    real phi = 2*PI*u.y;
+    Moebius m = mo_chain(hy_zrotate(phi), hy_xshift(r));
+    v = mo_deriv(
+        mo_inverse(hy_look_at(mo_apply(mo_inverse(m), f))),
+        QJ, QJ
+    );
+
+    HyRay ray;
+    ray.direction = normalize(mo_deriv(m, QJ, v));
+    ray.start = mo_apply(m, QJ);
+
+    return ray;
+}
+
+bool view_project(View view, quaternion pos, int2 size, real2 *pixel) {
+    quaternion p = mo_apply(mo_inverse(view.position), pos);
+    // Direction of the line from the camera at *j* to the point.
+    quaternion v = mo_deriv(mo_inverse(hy_look_at(p)), QJ, QJ);
+    if (v.z <= (real)0) {
+        return false;
+    }
+    real k = view.field_of_view*size.y/v.z;
+    *pixel = make_real2(k*v.x + (real)0.5*size.x, k*v.y + (real)0.5*size.y);
+    return true;
+}
+
 #ifdef OPENCL_INTEROP
 
 ViewPk view_pack(View v) {
@@ -44,4 +108,57 @@ View view_unpack(ViewPk v) {
     return o;
 }
 
+ViewMotionPk view_motion_pack(ViewMotion m) {
+    ViewMotionPk o;
+    o.position = mo_path_pack(m.position);
+    for (int i = 0; i < 2; ++i) {
+        o.field_of_view[i] = m.field_of_view[i];
+        o.lens_radius[i] = m.lens_radius[i];
+        o.focal_length[i] = m.focal_length[i];
+    }
+    return o;
+}
+ViewMotion view_motion_unpack(ViewMotionPk m) {
+    ViewMotion o;
+    o.position = mo_path_unpack(m.position);
+    for (int i = 0; i < 2; ++i) {
+        o.field_of_view[i] = m.field_of_view[i];
+        o.lens_radius[i] = m.lens_radius[i];
+        o.focal_length[i] = m.focal_length[i];
+    }
+    return o;
+}
+
 #endif // OPENCL_INTEROP
+
+
+#ifdef UNIT_TEST
+#include <catch.hpp>
+
+TEST_CASE("View", "[view]") {
+    TestRng rng;
+
+    SECTION("Projection of a point on the primary ray") {
+        const int2 size = make_int2(800, 600);
+        for (int i = 0; i < TEST_ATTEMPTS; ++i) {
+            View view = view_position(random_moebius(rng));
+            real2 pix = make_real2(size.x*rng.uniform(), size.y*rng.uniform());
+            quaternion v = q_new(
+                (pix.x - (real)0.5*size.x)/size.y,
+                (pix.y - (real)0.5*size.y)/size.y,
+                view.field_of_view, (real)0
+            );
+            real d = (real)0.1 + 10*rng.uniform();
+            quaternion p = mo_apply(mo_chain(
+                view.position,
+                mo_chain(mo_inverse(hy_look_to(v)), hy_zshift(d))
+            ), QJ);
+
+            real2 proj;
+            REQUIRE(view_project(view, p, size, &proj));
+            REQUIRE(proj.x == Approx(pix.x).epsilon(1e-4));
+            REQUIRE(proj.y == Approx(pix.y).epsilon(1e-4));
+        }
+    }
+};
+#endif // UNIT_TEST
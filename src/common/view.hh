@@ -2,8 +2,11 @@
 
 #include <types.hh>
 
+#include <random.hh>
+
 #include <algebra/real.hh>
 #include <algebra/moebius.hh>
+#include <geometry/hyperbolic/ray.hh>
 
 
 typedef struct {
@@ -24,14 +27,54 @@ typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
 
 #endif // OPENCL_INTEROP
 
+// Motion of the camera between two views. The position path
+// is precomputed on the host, see `mo_path_new`.
+typedef struct {
+    MoebiusPath position;
+    // Parameters at the start and at the end of the motion.
+    real field_of_view[2];
+    real lens_radius[2];
+    real focal_length[2];
+} ViewMotion;
+
+#ifdef OPENCL_INTEROP
+
+typedef struct _PACKED_STRUCT_ATTRIBUTE_ {
+    MoebiusPathPk position;
+    real_pk field_of_view[2];
+    real_pk lens_radius[2];
+    real_pk focal_length[2];
+} ViewMotionPk;
+
+#endif // OPENCL_INTEROP
+
 
 View view_init();
 View view_position(Moebius m);
 View view_interpolate(View a, View b, real t);
+// Motion from `a` to `b`, `view_motion_at` evaluated at `t`
+// is the same as `view_interpolate(a, b, t)`.
+ViewMotion view_motion_new(View a, View b);
+View view_motion_at(const ViewMotion *motion, real t);
+
+// Draws a ray passing through the lens of radius `lens_radius`
+// and focused at `focal_length` in the direction `v`.
+HyRay draw_from_lens(
+    Rng *rng,
+    quaternion v,
+    real focal_length, real lens_radius
+);
+
+// Position in pixels of the point `pos` seen from the `view` in the image
+// of the `size`, i.e. the inverse of the primary ray without the lens.
+// Returns false if the point is behind the camera.
+bool view_project(View view, quaternion pos, int2 size, real2 *pixel);
 
 #ifdef OPENCL_INTEROP
 
 ViewPk view_pack(View v);
 View view_unpack(ViewPk v);
+ViewMotionPk view_motion_pack(ViewMotion m);
+ViewMotion view_motion_unpack(ViewMotionPk m);
 
 #endif // OPENCL_INTEROP
@@ -0,0 +1,103 @@
+// Adaptive sampling.
+//
+// Besides the running mean in `screen` every pixel has the running mean
+// of squared samples in `screen_sq` and its own sample count. `update_active`
+// collects the pixels which mean is not known precisely enough yet
+// into the list of active pixels, the rest are converged. `render_adaptive`
+// samples only the active pixels, and the whole `screen` is converted
+// to the output image by `write_image` before it is read back.
+
+
+__kernel void render_adaptive(
+	__global float *screen,
+	__global float *screen_sq,
+	__global int *sample_counts,
+	int width, int height,
+	int frame_no,
+
+	ViewPk view_pk,
+	__global ViewMotionPk *view_motion,
+
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev,
+	__global uchar *objects_mask,
+	const int object_count,
+
+	__global BvhNodePk *bvh_nodes,
+	__global int *bvh_indices,
+	const int bvh_node_count,
+	const int bvh_unbounded_count,
+
+	__global GroupPk *groups,
+
+	__global int *active_pixels,
+	__global uint *ray_counter
+) {
+	int idx = active_pixels[get_global_id(0)];
+	// Own sample count of the pixel keeps its low-discrepancy sequence contiguous.
+	int sample_no = sample_counts[idx];
+	const TraceConfig config = TRACE_CONFIG;
+	Rng rng;
+	rand_init(&rng, idx, frame_no, sample_no, 0, config.low_discrepancy);
+
+	const Scene scene = scene_new(
+		objects_geometry, objects_motion,
+		objects_shading, objects_shading_prev,
+		objects_mask, object_count,
+		bvh_nodes, bvh_indices,
+		bvh_node_count, bvh_unbounded_count,
+		groups
+	);
+
+	int rays = 0;
+	float3 color = trace_sample(
+		&scene, &config, &rng,
+		view_unpack(view_pk), view_motion,
+		(int2)(idx % width, idx / width), (int2)(width, height),
+		&rays, 0
+	);
+#ifdef COUNT_RAYS
+	atomic_add(ray_counter, (uint)rays);
+#endif // COUNT_RAYS
+
+	float3 avg_color = (color + vload3(idx, screen)*sample_no)/(sample_no + 1);
+	vstore3(avg_color, idx, screen);
+	float3 avg_sq = (color*color + vload3(idx, screen_sq)*sample_no)/(sample_no + 1);
+	vstore3(avg_sq, idx, screen_sq);
+	sample_counts[idx] = sample_no + 1;
+}
+
+// Pixel is converged when the standard error of its mean is below `threshold`
+// in every channel. Each pixel gets at least `min_samples` before the test.
+// `active_count` must be zeroed before the launch.
+__kernel void update_active(
+	__global float *screen,
+	__global float *screen_sq,
+	__global int *sample_counts,
+	__global int *active_pixels,
+	__global int *active_count,
+	int fresh,
+	int min_samples,
+	float threshold
+) {
+	int idx = get_global_id(0);
+
+	bool active = true;
+	if (fresh) {
+		sample_counts[idx] = 0;
+	} else {
+		int n = sample_counts[idx];
+		if (n >= min_samples) {
+			float3 mean = vload3(idx, screen);
+			float3 var = max(vload3(idx, screen_sq) - mean*mean, 0.0f);
+			float3 err = sqrt(var/n);
+			active = max(err.x, max(err.y, err.z)) > threshold;
+		}
+	}
+
+	if (active) {
+		active_pixels[atomic_inc(active_count)] = idx;
+	}
+}
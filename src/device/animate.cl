@@ -0,0 +1,44 @@
+// Evaluation of the animation tracks.
+//
+// Every track is a single object, the `i`-th track is written to the `i`-th
+// records of the object buffers. The state at the closing of the shutter
+// goes to the current records, the one at its opening to the previous
+// shading, and the motion segments are the parts of the track paths
+// between the keyframes evenly spaced over the shutter interval.
+
+
+__kernel void animate_tracks(
+	__global const TrackPk *tracks,
+	__global const TrackKeyPk *keys,
+	const int track_count,
+	float time, float shutter,
+
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev
+) {
+	int i = get_global_id(0);
+	if (i >= track_count) {
+		return;
+	}
+	const TrackPk track = tracks[i];
+	__global const TrackKeyPk *track_keys = keys + track.first;
+
+	ObjectGeometryPk geometry;
+	ObjectShadingPk shading;
+	track_evaluate(track_keys, track.count, time, &geometry, &shading);
+	objects_geometry[i] = geometry;
+	objects_shading[i] = shading;
+
+	track_evaluate(track_keys, track.count, time - shutter, &geometry, &shading);
+	objects_shading_prev[i] = shading;
+
+	for (int s = 0; s < MOTION_SEGMENTS; ++s) {
+		float t0 = time - shutter*(MOTION_SEGMENTS - s)/MOTION_SEGMENTS;
+		float t1 = time - shutter*(MOTION_SEGMENTS - s - 1)/MOTION_SEGMENTS;
+		objects_motion[i*MOTION_SEGMENTS + s] = mo_path_pack(
+			track_path(track_keys, track.count, t0, t1)
+		);
+	}
+}
@@ -2,6 +2,7 @@
 #define OPENCL_INTEROP
 
 #include <gen/config.cl>
+#include <gen/scene.cl>
 
 #include <types.hh>
 #include <random.hh>
@@ -13,157 +14,237 @@
 
 #include <object.hh>
 #include <view.hh>
-#include <path.hh>
+#include <trace.hh>
+#include <track.hh>
 
-#include <lens_blur.cl>
 
-void get_object(Object *obj, int i, __global ObjectPk *objects) {
-	ObjectPk obj_pk = objects[i];
-	unpack_object(obj, &obj_pk);
+// Writes the linear `color` of the pixel to the output image.
+void write_pixel(__global uchar *image, int idx, float3 color) {
+	float3 out_color = clamp(color, 0.0f, 1.0f);
+#ifdef GAMMA_CORRECTION
+	out_color = pow(out_color, 1/GAMMA_VALUE);
+#endif // GAMMA_CORRECTION
+
+	uchar4 pix = (uchar4)(convert_uchar3(255*out_color), 0xff);
+	vstore4(pix, idx, image);
+}
+
+// Adds the `sample_count` samples summed in `color` to the running
+// average of the pixel and writes it to the output image.
+void accumulate_pixel(
+	__global float *screen,
+	__global uchar *image,
+	int idx, int sample_no, int sample_count,
+	float3 color
+) {
+	float3 avg_color = (color + vload3(idx, screen)*sample_no)/(sample_no + sample_count);
+	vstore3(avg_color, idx, screen);
+
+	write_pixel(image, idx, avg_color);
 }
 
-void get_object_interpolate(
-	Object *obj, int i, real t,
-	__global ObjectPk *objects,
-	__global ObjectPk *objects_prev,
-	__global uchar *objects_mask
+Scene scene_new(
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev,
+	__global uchar *objects_mask,
+	const int object_count,
+
+	__global BvhNodePk *bvh_nodes,
+	__global int *bvh_indices,
+	const int bvh_node_count,
+	const int bvh_unbounded_count,
+
+	__global GroupPk *groups
 ) {
-	ObjectPk obj_pk = objects[i];
-	if (objects_mask[i] != 0) {
-		ObjectPk obj_prev_pk = objects_prev[i];
-		Object obj_orig, obj_prev;
-		unpack_object(&obj_orig, &obj_pk);
-		unpack_object(&obj_prev, &obj_prev_pk);
-		object_interpolate(obj, &obj_prev, &obj_orig, t);
-	} else {
-		unpack_object(obj, &obj_pk);
+	Scene scene;
+	scene.geometry = objects_geometry;
+	scene.motion = objects_motion;
+	scene.motion_segments = MOTION_SEGMENTS;
+	scene.shading = objects_shading;
+	scene.shading_prev = objects_shading_prev;
+	scene.objects_mask = objects_mask;
+	scene.object_count = object_count;
+	scene.bvh_nodes = bvh_nodes;
+	scene.bvh_indices = bvh_indices;
+	scene.bvh_node_count = bvh_node_count;
+	scene.bvh_unbounded_count = bvh_unbounded_count;
+	scene.groups = groups;
+	return scene;
+}
+
+// Traces `sample_count` samples of the `idx`-th pixel starting from
+// `sample_no` of the `frame_no`-th image. They are summed in registers, so the pixel is read
+// and written once per launch.
+void render_pixel(
+	__global float *screen,
+	__global uchar *image,
+	int idx, int width, int height,
+	int frame_no, int sample_no, int sample_count,
+	ViewPk view_pk, __global ViewMotionPk *view_motion,
+	const Scene *scene,
+	__global uint *ray_counter
+) {
+	const TraceConfig config = TRACE_CONFIG;
+	const View view = view_unpack(view_pk);
+
+	int rays = 0;
+	float3 color = (float3)(0.0f);
+	for (int i = 0; i < sample_count; ++i) {
+		Rng rng;
+		rand_init(&rng, idx, frame_no, sample_no + i, 0, config.low_discrepancy);
+		color += trace_sample(
+			scene, &config, &rng,
+			view, view_motion,
+			(int2)(idx % width, idx / width), (int2)(width, height),
+			&rays, 0
+		);
 	}
+#ifdef COUNT_RAYS
+	atomic_add(ray_counter, (uint)rays);
+#endif // COUNT_RAYS
+
+	accumulate_pixel(screen, image, idx, sample_no, sample_count, color);
 }
 
 __kernel void render(
 	__global float *screen,
 	__global uchar *image,
 	int width, int height,
-	int sample_no,
-	__global uint *seeds,
+	int frame_no, int sample_no, int sample_count,
 
 	ViewPk view_pk,
-	ViewPk view_prev_pk,
+	__global ViewMotionPk *view_motion,
 
-	__global ObjectPk *objects,
-	__global ObjectPk *objects_prev,
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev,
 	__global uchar *objects_mask,
-	const int object_count
+	const int object_count,
+
+	__global BvhNodePk *bvh_nodes,
+	__global int *bvh_indices,
+	const int bvh_node_count,
+	const int bvh_unbounded_count,
+
+	__global GroupPk *groups,
+
+	__global uint *ray_counter
 ) {
 	int idx = get_global_id(0);
-	Rng rng;
-	rand_init(&rng, seeds[idx]);
-
-	View view = view_unpack(view_pk);
 
-	real time = rand_uniform(&rng);
-#ifdef MOTION_BLUR
-	view = view_interpolate(view_unpack(view_prev_pk), view, time);
-#endif // MOTION_BLUR
+	const Scene scene = scene_new(
+		objects_geometry, objects_motion,
+		objects_shading, objects_shading_prev,
+		objects_mask, object_count,
+		bvh_nodes, bvh_indices,
+		bvh_node_count, bvh_unbounded_count,
+		groups
+	);
 
-	quaternion v = q_new(
-		((real)(idx % width) - 0.5f*width + rand_uniform(&rng))/height,
-		((real)(idx / width) - 0.5f*height + rand_uniform(&rng))/height,
-		view.field_of_view, 0.0f
+	render_pixel(
+		screen, image,
+		idx, width, height,
+		frame_no, sample_no, sample_count,
+		view_pk, view_motion,
+		&scene,
+		ray_counter
 	);
+}
 
-	float3 color = (float3)(0.0f);
+// The same as `render` launched as a 2D range over the image, so a work
+// group traces a rectangular tile of neighbouring pixels. The range is
+// rounded up to whole work groups, the items outside of the image exit.
+__kernel void render_tiled(
+	__global float *screen,
+	__global uchar *image,
+	int width, int height,
+	int frame_no, int sample_no, int sample_count,
+
+	ViewPk view_pk,
+	__global ViewMotionPk *view_motion,
+
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev,
+	__global uchar *objects_mask,
+	const int object_count,
+
+	__global BvhNodePk *bvh_nodes,
+	__global int *bvh_indices,
+	const int bvh_node_count,
+	const int bvh_unbounded_count,
 
-	HyRay ray = hyray_init();
-	ray.direction = v;
-#ifdef LENS_BLUR
-	ray = draw_from_lens(&rng, v, view.focal_length, view.lens_radius);
-#endif // LENS_BLUR
-	ray = hyray_map(view.position, ray);
-
-	float3 light = (float3)(1.0f);
-
-	PathInfo gpath = {
-		.repeat = false,
-		.face = false,
-		.diffuse = false		
-	};
-	int prev = -1;
-	int diffuse = 0;
-	for (int k = 0; k < PATH_MAX_DEPTH; ++k) {
-		int mi = -1;
-		float ml = -1.0f;
-		ObjectHit mcache;
-		PathInfo mpath;
-		for (int i = 0; i < object_count; ++i) {
-			Object obj;
-#ifdef OBJECT_MOTION_BLUR
-			get_object_interpolate(
-				&obj, i, time,
-				objects, objects_prev, objects_mask
-			);
-#else  // OBJECT_MOTION_BLUROBJECT_MOTION_BLUR
-			get_object(&obj, i, objects);
-#endif // OBJECT_MOTION_BLUROBJECT_MOTION_BLUR
-			
-			ObjectHit cache;
-			PathInfo path = gpath;
-			path.repeat = (prev == i);
-			real l = object_hit(&obj, &cache, &rng, &path, ray);
-			if (l > (real)0 && (l < ml || mi < 0)) {
-				mi = i;
-				ml = l;
-				mcache = cache;
-				mpath = path;
-			}
-		}
-
-		if (mi >= 0) {
-			HyRay new_ray;
-			Object obj;
-#ifdef OBJECT_MOTION_BLUR
-			get_object_interpolate(
-				&obj, mi, time,
-				objects, objects_prev, objects_mask
-			);
-#else  // OBJECT_MOTION_BLUR
-			get_object(&obj, mi, objects);
-#endif // OBJECT_MOTION_BLUR
-			if (!object_bounce(
-				&obj, &mcache,
-				&rng, &mpath,
-				&ray,
-				&light, &color
-			)) {
-				break;
-			}
-		} else {
-			color += (float3)(1.0f)*light;
-			break;
-		}
-		prev = mi;
-		gpath = mpath;
-		if (gpath.diffuse) {
-			if (diffuse >= PATH_MAX_DIFFUSE_DEPTH) {
-				break;
-			}
-			diffuse += 1;
-		}
+	__global GroupPk *groups,
+
+	__global uint *ray_counter
+) {
+	int x = get_global_id(0), y = get_global_id(1);
+	if (x >= width || y >= height) {
+		return;
 	}
 
-	seeds[idx] = rng.state;
+	const Scene scene = scene_new(
+		objects_geometry, objects_motion,
+		objects_shading, objects_shading_prev,
+		objects_mask, object_count,
+		bvh_nodes, bvh_indices,
+		bvh_node_count, bvh_unbounded_count,
+		groups
+	);
 
-	float3 avg_color = (color + vload3(idx, screen)*sample_no)/(sample_no + 1);
-	vstore3(avg_color, idx, screen);
+	render_pixel(
+		screen, image,
+		x + y*width, width, height,
+		frame_no, sample_no, sample_count,
+		view_pk, view_motion,
+		&scene,
+		ray_counter
+	);
+}
 
-	float3 out_color = clamp(avg_color, 0.0f, 1.0f);
-#ifdef GAMMA_CORRECTION
-	out_color = pow(out_color, 1/GAMMA_VALUE);
-#endif // GAMMA_CORRECTION
 
-	uchar4 pix = (uchar4)(convert_uchar3(255*out_color), 0xff);
-	vstore4(pix, idx, image);
+// Writes the whole output image from the accumulated colors.
+__kernel void write_image(
+	__global float *screen,
+	__global uchar *image
+) {
+	int idx = get_global_id(0);
+	write_pixel(image, idx, vload3(idx, screen));
 }
 
+// Fills the `width` x `height` output image from the accumulated colors
+// of the smaller `src_width` x `src_height` one with bilinear filtering.
+__kernel void upscale_image(
+	__global float *screen,
+	__global uchar *image,
+	int src_width, int src_height,
+	int width, int height
+) {
+	int idx = get_global_id(0);
+	float2 size = (float2)(src_width, src_height);
+	float2 p = ((float2)(idx % width, idx / width) + 0.5f)*size/(float2)(width, height) - 0.5f;
+	p = clamp(p, 0.0f, size - 1.0f);
+
+	int2 a = convert_int2(p);
+	int2 b = min(a + 1, (int2)(src_width - 1, src_height - 1));
+	float2 f = p - convert_float2(a);
+	float3 color = mix(
+		mix(vload3(a.x + a.y*src_width, screen), vload3(b.x + a.y*src_width, screen), f.x),
+		mix(vload3(a.x + b.y*src_width, screen), vload3(b.x + b.y*src_width, screen), f.x),
+		f.y
+	);
+
+	write_pixel(image, idx, color);
+}
+
+
+#include <wavefront.cl>
+#include <adaptive.cl>
+#include <temporal.cl>
+#include <animate.cl>
 
 #include <source.cl>
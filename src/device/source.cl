@@ -11,6 +11,7 @@
 
 #include <geometry/hyperbolic.cc>
 #include <geometry/hyperbolic/ray.cc>
+#include <geometry/hyperbolic/tiling.cc>
 #include <geometry/hyperbolic/plane.cc>
 #include <geometry/hyperbolic/horosphere.cc>
 
@@ -18,3 +19,7 @@
 #include <material.cc>
 #include <object.cc>
 #include <view.cc>
+#include <bvh.cc>
+#include <group.cc>
+#include <trace.cc>
+#include <track.cc>
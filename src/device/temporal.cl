@@ -0,0 +1,108 @@
+// Temporal accumulation.
+//
+// Besides the running mean in `screen` every pixel stores the position
+// of its first hit in the scene and its own sample count. When the view
+// changes the accumulated samples are not discarded: the first hit of the
+// new sample is projected to the view the history was rendered with,
+// and the history of that pixel is taken if its first hit is close enough.
+// Otherwise the pixel is disoccluded and starts over. Positions are
+// in the scene coordinates, so they don't depend on the view.
+
+
+__kernel void render_temporal(
+	__global float *screen,
+	__global uchar *image,
+	__global float *hits,
+	__global int *sample_counts,
+	int width, int height,
+	int frame_no, int sample_no,
+
+	// History is read only by the reprojection,
+	// otherwise the pixel is accumulated in place.
+	__global float *history_screen,
+	__global float *history_hits,
+	__global int *history_counts,
+	int history_width, int history_height,
+	ViewPk history_view_pk,
+	int fresh, int reproject,
+	int max_history,
+	float hit_tolerance,
+
+	ViewPk view_pk,
+	__global ViewMotionPk *view_motion,
+
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev,
+	__global uchar *objects_mask,
+	const int object_count,
+
+	__global BvhNodePk *bvh_nodes,
+	__global int *bvh_indices,
+	const int bvh_node_count,
+	const int bvh_unbounded_count,
+
+	__global GroupPk *groups,
+
+	__global uint *ray_counter
+) {
+	int x = get_global_id(0), y = get_global_id(1);
+	if (x >= width || y >= height) {
+		return;
+	}
+	int idx = x + y*width;
+
+	const TraceConfig config = TRACE_CONFIG;
+	Rng rng;
+	rand_init(&rng, idx, frame_no, sample_no, 0, config.low_discrepancy);
+
+	const Scene scene = scene_new(
+		objects_geometry, objects_motion,
+		objects_shading, objects_shading_prev,
+		objects_mask, object_count,
+		bvh_nodes, bvh_indices,
+		bvh_node_count, bvh_unbounded_count,
+		groups
+	);
+
+	int rays = 0;
+	quaternion hit;
+	float3 color = trace_sample(
+		&scene, &config, &rng,
+		view_unpack(view_pk), view_motion,
+		(int2)(x, y), (int2)(width, height),
+		&rays, &hit
+	);
+#ifdef COUNT_RAYS
+	atomic_add(ray_counter, (uint)rays);
+#endif // COUNT_RAYS
+
+	float3 mean = (float3)(0.0f);
+	int n = 0;
+	if (reproject) {
+		real2 p;
+		if (
+			hit.w >= 0.0f &&
+			view_project(view_unpack(history_view_pk), hit, (int2)(history_width, history_height), &p) &&
+			p.x >= 0.0f && p.y >= 0.0f && p.x < history_width && p.y < history_height
+		) {
+			int hidx = (int)p.x + (int)p.y*history_width;
+			float4 h = vload4(hidx, history_hits);
+			if (h.w >= 0.0f && hy_distance(q_new(h.xyz, R0), q_new(hit.xyz, R0)) < hit_tolerance) {
+				mean = vload3(hidx, history_screen);
+				n = min(history_counts[hidx], max_history);
+			}
+		}
+	} else if (!fresh) {
+		mean = vload3(idx, screen);
+		n = sample_counts[idx];
+	}
+
+	mean = (color + mean*n)/(n + 1);
+	vstore3(mean, idx, screen);
+	vstore4(hit, idx, hits);
+	sample_counts[idx] = n + 1;
+
+	write_pixel(image, idx, mean);
+}
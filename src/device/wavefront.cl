@@ -0,0 +1,305 @@
+// Wavefront path tracer.
+//
+// Every pixel has its own path which state is stored as structure of arrays
+// between the kernels. The host launches `wf_generate` once, then
+// `wf_intersect` and `wf_shade` for every bounce, and `wf_accumulate` at last.
+// `wf_shade` compacts the paths that continue into the other index list,
+// so the next bounce runs only on the active paths without gaps between them.
+
+
+// Device buffers holding the state of all paths.
+typedef struct {
+	__global float4 *ray_start;
+	__global float4 *ray_direction;
+	__global float *color;
+	__global float *light;
+	__global int *flags;
+	__global int *prev;
+	__global int *diffuse;
+	__global float *time;
+} PathBuffers;
+
+int path_info_pack(PathInfo info) {
+	return (int)info.repeat | ((int)info.face << 1) | ((int)info.diffuse << 2);
+}
+PathInfo path_info_unpack(int flags) {
+	PathInfo info;
+	info.repeat = (flags & 1) != 0;
+	info.face = (flags & 2) != 0;
+	info.diffuse = (flags & 4) != 0;
+	return info;
+}
+
+void path_load(const PathBuffers *buf, int p, PathState *state, real *time) {
+	state->ray.start = buf->ray_start[p];
+	state->ray.direction = buf->ray_direction[p];
+	state->color = vload3(p, buf->color);
+	state->light = vload3(p, buf->light);
+	state->path = path_info_unpack(buf->flags[p]);
+	state->prev = buf->prev[p];
+	state->diffuse = buf->diffuse[p];
+	*time = buf->time[p];
+}
+void path_store(const PathBuffers *buf, int p, const PathState *state, real time) {
+	buf->ray_start[p] = state->ray.start;
+	buf->ray_direction[p] = state->ray.direction;
+	vstore3(state->color, p, buf->color);
+	vstore3(state->light, p, buf->light);
+	buf->flags[p] = path_info_pack(state->path);
+	buf->prev[p] = state->prev;
+	buf->diffuse[p] = state->diffuse;
+	buf->time[p] = time;
+}
+
+PathBuffers path_buffers_new(
+	__global float4 *ray_start,
+	__global float4 *ray_direction,
+	__global float *path_color,
+	__global float *path_light,
+	__global int *path_flags,
+	__global int *path_prev,
+	__global int *path_diffuse,
+	__global float *path_time
+) {
+	PathBuffers buf;
+	buf.ray_start = ray_start;
+	buf.ray_direction = ray_direction;
+	buf.color = path_color;
+	buf.light = path_light;
+	buf.flags = path_flags;
+	buf.prev = path_prev;
+	buf.diffuse = path_diffuse;
+	buf.time = path_time;
+	return buf;
+}
+
+__kernel void wf_generate(
+	int width, int height,
+	int frame_no, int sample_no,
+
+	ViewPk view_pk,
+	__global ViewMotionPk *view_motion,
+
+	__global float4 *ray_start,
+	__global float4 *ray_direction,
+	__global float *path_color,
+	__global float *path_light,
+	__global int *path_flags,
+	__global int *path_prev,
+	__global int *path_diffuse,
+	__global float *path_time,
+
+	__global int *paths_out,
+	__global int *path_count_out
+) {
+	int idx = get_global_id(0);
+	const TraceConfig config = TRACE_CONFIG;
+	Rng rng;
+	rand_init(&rng, idx, frame_no, sample_no, 0, config.low_discrepancy);
+
+	const PathBuffers buf = path_buffers_new(
+		ray_start, ray_direction,
+		path_color, path_light,
+		path_flags, path_prev, path_diffuse,
+		path_time
+	);
+
+	real time;
+	HyRay ray = trace_camera(
+		&config, &rng, &time,
+		view_unpack(view_pk), view_motion,
+		(int2)(idx % width, idx / width), (int2)(width, height)
+	);
+	PathState state;
+	path_init(&state, ray);
+	path_store(&buf, idx, &state, time);
+
+	paths_out[idx] = idx;
+	if (idx == 0) {
+		*path_count_out = width*height;
+	}
+}
+
+__kernel void wf_intersect(
+	int frame_no, int sample_no, int depth,
+
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev,
+	__global uchar *objects_mask,
+	const int object_count,
+
+	__global BvhNodePk *bvh_nodes,
+	__global int *bvh_indices,
+	const int bvh_node_count,
+	const int bvh_unbounded_count,
+
+	__global GroupPk *groups,
+
+	__global float4 *ray_start,
+	__global float4 *ray_direction,
+	__global float *path_color,
+	__global float *path_light,
+	__global int *path_flags,
+	__global int *path_prev,
+	__global int *path_diffuse,
+	__global float *path_time,
+
+	__global int *hit_index,
+	__global float4 *hit_pos,
+	__global float4 *hit_dir,
+	__global int *hit_flags,
+	__global MoebiusPk *hit_element,
+
+	__global int *paths_in,
+	__global int *path_count_in,
+	__global int *path_count_out,
+
+	__global uint *ray_counter
+) {
+	int i = get_global_id(0);
+	// Nobody reads the output counter until the next shading stage.
+	if (i == 0) {
+		*path_count_out = 0;
+	}
+	if (i >= *path_count_in) {
+		return;
+	}
+	int p = paths_in[i];
+
+	// Every stage of every depth draws from its own stream.
+	const TraceConfig config = TRACE_CONFIG;
+	Rng rng;
+	rand_init(&rng, p, frame_no, sample_no, 2*depth + 1, config.low_discrepancy);
+
+	const Scene scene = scene_new(
+		objects_geometry, objects_motion,
+		objects_shading, objects_shading_prev,
+		objects_mask, object_count,
+		bvh_nodes, bvh_indices,
+		bvh_node_count, bvh_unbounded_count,
+		groups
+	);
+	const PathBuffers buf = path_buffers_new(
+		ray_start, ray_direction,
+		path_color, path_light,
+		path_flags, path_prev, path_diffuse,
+		path_time
+	);
+
+	PathState state;
+	real time;
+	path_load(&buf, p, &state, &time);
+
+	ObjectHit hit;
+	PathInfo hpath = state.path;
+	int mi = scene_hit(
+		&scene, &config, &rng, time,
+		state.ray, state.prev,
+		&hit, &hpath
+	);
+
+#ifdef COUNT_RAYS
+	atomic_inc(ray_counter);
+#endif // COUNT_RAYS
+
+	hit_index[p] = mi;
+	hit_pos[p] = hit.pos;
+	hit_dir[p] = hit.dir;
+	hit_flags[p] = path_info_pack(hpath);
+	hit_element[p] = mo_pack(hit.element);
+}
+
+__kernel void wf_shade(
+	int frame_no, int sample_no, int depth,
+
+	__global ObjectGeometryPk *objects_geometry,
+	__global MoebiusPathPk *objects_motion,
+	__global ObjectShadingPk *objects_shading,
+	__global ObjectShadingPk *objects_shading_prev,
+	__global uchar *objects_mask,
+	const int object_count,
+
+	__global BvhNodePk *bvh_nodes,
+	__global int *bvh_indices,
+	const int bvh_node_count,
+	const int bvh_unbounded_count,
+
+	__global GroupPk *groups,
+
+	__global float4 *ray_start,
+	__global float4 *ray_direction,
+	__global float *path_color,
+	__global float *path_light,
+	__global int *path_flags,
+	__global int *path_prev,
+	__global int *path_diffuse,
+	__global float *path_time,
+
+	__global int *hit_index,
+	__global float4 *hit_pos,
+	__global float4 *hit_dir,
+	__global int *hit_flags,
+	__global MoebiusPk *hit_element,
+
+	__global int *paths_in,
+	__global int *path_count_in,
+	__global int *paths_out,
+	__global int *path_count_out
+) {
+	int i = get_global_id(0);
+	if (i >= *path_count_in) {
+		return;
+	}
+	int p = paths_in[i];
+
+	const TraceConfig config = TRACE_CONFIG;
+	Rng rng;
+	rand_init(&rng, p, frame_no, sample_no, 2*depth + 2, config.low_discrepancy);
+
+	const Scene scene = scene_new(
+		objects_geometry, objects_motion,
+		objects_shading, objects_shading_prev,
+		objects_mask, object_count,
+		bvh_nodes, bvh_indices,
+		bvh_node_count, bvh_unbounded_count,
+		groups
+	);
+	const PathBuffers buf = path_buffers_new(
+		ray_start, ray_direction,
+		path_color, path_light,
+		path_flags, path_prev, path_diffuse,
+		path_time
+	);
+
+	PathState state;
+	real time;
+	path_load(&buf, p, &state, &time);
+
+	ObjectHit hit;
+	hit.pos = hit_pos[p];
+	hit.dir = hit_dir[p];
+	hit.element = mo_unpack(hit_element[p]);
+	bool alive = path_shade(
+		&scene, &config, &rng, time,
+		&state,
+		hit_index[p], &hit, path_info_unpack(hit_flags[p])
+	);
+	path_store(&buf, p, &state, time);
+
+	if (alive) {
+		paths_out[atomic_inc(path_count_out)] = p;
+	}
+}
+
+__kernel void wf_accumulate(
+	__global float *screen,
+	__global uchar *image,
+	int sample_no,
+
+	__global float *path_color
+) {
+	int idx = get_global_id(0);
+	accumulate_pixel(screen, image, idx, sample_no, 1, vload3(idx, path_color));
+}
@@ -0,0 +1,24 @@
+#include "adaptive.hpp"
+
+#include <vector>
+
+
+AdaptiveSampler::AdaptiveSampler(cl_context context, cl_command_queue queue, cl_program program, int pixel_count) :
+    render(program, "render_adaptive"),
+    update_active(program, "update_active"),
+
+    screen_sq(context, pixel_count*3*sizeof(cl_float)),
+    sample_counts(context, pixel_count*sizeof(cl_int)),
+    active_pixels(context, pixel_count*sizeof(cl_int)),
+    active_count(context, sizeof(cl_int))
+{
+    const std::vector<cl_float> zero_colors(pixel_count*3, 0.0f);
+    screen_sq.store(queue, zero_colors.data());
+    const std::vector<cl_int> zero_counts(pixel_count, 0);
+    sample_counts.store(queue, zero_counts.data());
+}
+
+void AdaptiveSampler::load_kernels(cl_program program) {
+    render = cl::Kernel(program, "render_adaptive");
+    update_active = cl::Kernel(program, "update_active");
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <opencl/opencl.hpp>
+
+
+// Kernels and device buffers of adaptive sampling,
+// see `src/device/adaptive.cl`.
+class AdaptiveSampler {
+    public:
+    cl::Kernel render;
+    cl::Kernel update_active;
+
+    cl::Buffer screen_sq;
+    cl::Buffer sample_counts;
+    cl::Buffer active_pixels;
+    cl::Buffer active_count;
+
+    // Number of pixels in `active_pixels` read back after the last update.
+    int active_pixel_count = 0;
+    // Passes rendered since the last update.
+    int passes = 0;
+
+    // The running means and the sample counts are zeroed through `queue`.
+    AdaptiveSampler(cl_context context, cl_command_queue queue, cl_program program, int pixel_count);
+    // Takes the kernels from the rebuilt `program`, the buffers are kept.
+    void load_kernels(cl_program program);
+};
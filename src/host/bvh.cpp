@@ -0,0 +1,101 @@
+#include "bvh.hpp"
+
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+
+Bvh::Bvh() = default;
+
+Bvh::Bvh(const std::vector<ObjectInstance> &objs, const std::vector<bool> &objs_mask) {
+    assert(objs.size() == objs_mask.size());
+
+    std::vector<Item> items;
+    for (size_t i = 0; i < objs.size(); ++i) {
+        Item item;
+        item.index = (int)i;
+        if (!objs_mask[i] && object_bound(&objs[i], &item.center, &item.radius)) {
+            items.push_back(item);
+        } else {
+            indices.push_back((int_pk)i);
+        }
+    }
+
+    // The hierarchy doesn't pay off for a few objects.
+    if (items.size() <= BVH_LEAF_SIZE) {
+        for (const Item &item : items) {
+            indices.push_back((int_pk)item.index);
+        }
+        items.clear();
+    }
+    unbounded_count = (int)indices.size();
+
+    if (items.size() > 0) {
+        build_node(items.begin(), items.end());
+    }
+}
+
+bool Bvh::is_bounded(const ObjectInstance &obj, bool moving) {
+    quaternion center;
+    real radius;
+    return !moving && object_bound(&obj, &center, &radius);
+}
+
+void Bvh::build_node(std::vector<Item>::iterator begin, std::vector<Item>::iterator end) {
+    // Bounding ball of the balls of all items around the center of their box.
+    real3 lo = begin->center.xyz, hi = lo;
+    for (auto it = begin; it != end; ++it) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], it->center[k] - it->radius);
+            hi[k] = std::max(hi[k], it->center[k] + it->radius);
+        }
+    }
+    real3 center = (lo + hi)/(real)2;
+    real radius = 0;
+    for (auto it = begin; it != end; ++it) {
+        radius = std::max(radius, length(it->center.xyz - center) + it->radius);
+    }
+    // Compensate precision loss of the device.
+    radius *= 1 + 1e-4;
+
+    size_t node_index = nodes.size();
+    nodes.push_back(BvhNodePk());
+    BvhNodePk &node = nodes.back();
+    node.ball = pack_real4(real4(center, radius));
+    node.first = (int_pk)indices.size();
+    node.count = 0;
+
+    size_t count = end - begin;
+    if (count <= BVH_LEAF_SIZE) {
+        for (auto it = begin; it != end; ++it) {
+            indices.push_back((int_pk)it->index);
+        }
+        node.count = (int_pk)count;
+    } else {
+        // Split by the median of the longest axis of the centers.
+        real3 clo = begin->center.xyz, chi = clo;
+        for (auto it = begin; it != end; ++it) {
+            for (int k = 0; k < 3; ++k) {
+                clo[k] = std::min(clo[k], it->center[k]);
+                chi[k] = std::max(chi[k], it->center[k]);
+            }
+        }
+        real3 ext = chi - clo;
+        int axis = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (ext[k] > ext[axis]) {
+                axis = k;
+            }
+        }
+        auto mid = begin + count/2;
+        std::nth_element(begin, mid, end, [axis](const Item &a, const Item &b) {
+            return a.center[axis] < b.center[axis];
+        });
+
+        build_node(begin, mid);
+        build_node(mid, end);
+    }
+
+    nodes[node_index].skip = (int_pk)nodes.size();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include <object.hh>
+#include <bvh.hh>
+
+
+// Bounding volume hierarchy built on the host and uploaded to the device.
+// The first `unbounded_count` entries of `indices` are the objects
+// that cannot be bounded (or that move during the frame), they are tested
+// for every ray. The rest of `indices` is referenced by the leaves.
+class Bvh {
+    public:
+    std::vector<BvhNodePk> nodes;
+    std::vector<int_pk> indices;
+    int unbounded_count = 0;
+
+    private:
+    struct Item {
+        int index;
+        quaternion center;
+        real radius;
+    };
+
+    void build_node(std::vector<Item>::iterator begin, std::vector<Item>::iterator end);
+
+    public:
+    Bvh();
+    Bvh(const std::vector<ObjectInstance> &objs, const std::vector<bool> &objs_mask);
+
+    // Whether the object is stored in the hierarchy
+    // rather than in the unbounded list.
+    static bool is_bounded(const ObjectInstance &obj, bool moving);
+};
@@ -0,0 +1,110 @@
+#include "pool.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+
+cpu::Pool::Pool(int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        threads.push_back(std::thread([this, i]() { loop(i); }));
+    }
+}
+cpu::Pool::~Pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+int cpu::Pool::size() const {
+    return (int)threads.size();
+}
+
+bool cpu::Pool::pop(int worker, int *task) {
+    Queue &queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    *task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool cpu::Pool::steal(int worker, int *task) {
+    int n = size();
+    for (int i = 1; i < n; ++i) {
+        Queue &queue = *queues[(worker + i) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            *task = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void cpu::Pool::work(int worker) {
+    int task;
+    while (pop(worker, &task) || steal(worker, &task)) {
+        func(task, worker);
+    }
+}
+
+void cpu::Pool::loop(int worker) {
+    int seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [&]() { return stop || generation != seen; });
+            if (stop) {
+                return;
+            }
+            seen = generation;
+        }
+
+        work(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy -= 1;
+        }
+        done_cv.notify_all();
+    }
+}
+
+void cpu::Pool::run(int task_count, std::function<void(int task, int worker)> f) {
+    int n = size();
+    // Contiguous chunks keep neighboring tasks on the same worker.
+    for (int i = 0; i < n; ++i) {
+        Queue &queue = *queues[i];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        assert(queue.tasks.empty());
+        for (int t = (task_count*i)/n; t < (task_count*(i + 1))/n; ++t) {
+            queue.tasks.push_back(t);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        func = std::move(f);
+        busy = n;
+        generation += 1;
+    }
+    start_cv.notify_all();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&]() { return busy == 0; });
+    func = nullptr;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+namespace cpu {
+    // Fixed set of worker threads executing indexed tasks.
+    // Tasks are initially split between per-worker queues,
+    // and a worker that runs out of its own tasks steals from the others.
+    class Pool {
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<int> tasks;
+        };
+
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        std::mutex mutex;
+        std::condition_variable start_cv, done_cv;
+        std::function<void(int task, int worker)> func;
+        int generation = 0;
+        int busy = 0;
+        bool stop = false;
+
+        bool pop(int worker, int *task);
+        bool steal(int worker, int *task);
+        void work(int worker);
+        void loop(int worker);
+
+    public:
+        // Zero `thread_count` means the number of hardware threads.
+        Pool(int thread_count=0);
+        ~Pool();
+
+        Pool(const Pool &other) = delete;
+        Pool &operator=(const Pool &other) = delete;
+
+        int size() const;
+
+        // Calls `func` for each task in `[0, task_count)` and
+        // blocks until all of them are done.
+        void run(int task_count, std::function<void(int task, int worker)> func);
+    };
+}
@@ -0,0 +1,342 @@
+#include "renderer.hpp"
+
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+
+using duration = std::chrono::duration<double>;
+
+CpuRenderer::CpuRenderer(
+    int width, int height,
+    const Config &config,
+    int thread_count
+) :
+    width(width),
+    height(height),
+
+    gamma(config.gamma),
+    samples_per_launch(std::max(config.batch.samples_per_launch, 1)),
+
+    pool(thread_count),
+
+    image(width*height*4),
+    screen(width*height*3, 0.0f)
+{
+    trace_config.path_max_depth = config.path_max_depth;
+    trace_config.path_max_diffuse_depth = config.path_max_diffuse_depth;
+    trace_config.lens_blur = config.blur.lens;
+    trace_config.motion_blur = config.blur.motion;
+    trace_config.object_motion_blur = config.blur.object_motion;
+    trace_config.motion_segments = config.blur.keyframes - 1;
+    trace_config.low_discrepancy = config.low_discrepancy;
+
+    set_view(view_init());
+}
+
+void CpuRenderer::store_objects(const std::vector<Object> &objs) {
+    store_objects(
+        objs,
+        std::vector<Object>(),
+        std::vector<bool>(objs.size(), false)
+    );
+}
+
+void CpuRenderer::store_objects(
+    const std::vector<Object> &objs,
+    const std::vector<Object> &objs_prev,
+    const std::vector<bool> &objs_mask
+) {
+    store_objects(objs, single_keyframe(objs_prev), objs_mask);
+}
+
+void CpuRenderer::store_objects(
+    const std::vector<Object> &objs,
+    const std::vector<std::vector<Object>> &objs_keyframes,
+    const std::vector<bool> &objs_mask
+) {
+    std::vector<ObjectPrototype> protos, protos_prev;
+    std::vector<ObjectInstance> insts;
+    std::vector<std::vector<ObjectInstance>> insts_keyframes;
+    split_objects(objs, &protos, &insts);
+    split_keyframes(objs_keyframes, &protos_prev, &insts_keyframes);
+    store_scene(protos, protos_prev, insts, insts_keyframes, objs_mask);
+}
+
+void CpuRenderer::store_objects(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectInstance> &insts
+) {
+    store_objects(
+        protos, insts,
+        std::vector<ObjectInstance>(),
+        std::vector<bool>(insts.size(), false)
+    );
+}
+
+void CpuRenderer::store_objects(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<ObjectInstance> &insts_prev,
+    const std::vector<bool> &insts_mask
+) {
+    store_objects(protos, insts, single_keyframe(insts_prev), insts_mask);
+}
+
+void CpuRenderer::store_objects(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    store_scene(protos, std::vector<ObjectPrototype>(), insts, insts_keyframes, insts_mask);
+}
+
+void CpuRenderer::update_objects(
+    int first,
+    const std::vector<Object> &objs,
+    const std::vector<Object> &objs_prev,
+    const std::vector<bool> &objs_mask
+) {
+    update_objects(first, objs, single_keyframe(objs_prev), objs_mask);
+}
+
+void CpuRenderer::update_objects(
+    int first,
+    const std::vector<Object> &objs,
+    const std::vector<std::vector<Object>> &objs_keyframes,
+    const std::vector<bool> &objs_mask
+) {
+    std::vector<ObjectPrototype> protos, protos_prev;
+    std::vector<ObjectInstance> insts;
+    std::vector<std::vector<ObjectInstance>> insts_keyframes;
+    split_objects(objs, &protos, &insts);
+    split_keyframes(objs_keyframes, &protos_prev, &insts_keyframes);
+    for (size_t i = 0; i < insts.size(); ++i) {
+        insts[i].prototype = first + (int)i;
+    }
+    update_scene(first, protos, protos_prev, insts, insts_keyframes, objs_mask);
+}
+
+void CpuRenderer::update_objects(
+    int first,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<ObjectInstance> &insts_prev,
+    const std::vector<bool> &insts_mask
+) {
+    update_objects(first, insts, single_keyframe(insts_prev), insts_mask);
+}
+
+void CpuRenderer::update_objects(
+    int first,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    update_scene(
+        first,
+        std::vector<ObjectPrototype>(), std::vector<ObjectPrototype>(),
+        insts, insts_keyframes, insts_mask
+    );
+}
+
+void CpuRenderer::store_scene(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectPrototype> &protos_prev,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    objects_shading.clear();
+    objects_shading_prev.clear();
+    objects_geometry.clear();
+    objects_motion.clear();
+    objects_mask.clear();
+    instances.clear();
+    instances_mask.clear();
+    bvh = Bvh();
+    update_scene(0, protos, protos_prev, insts, insts_keyframes, insts_mask);
+}
+
+void CpuRenderer::update_scene(
+    int first,
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectPrototype> &protos_prev,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    assert(first >= 0 && first <= (int)objects_geometry.size());
+    assert(insts.size() == insts_mask.size());
+
+    if (protos.size() > 0) {
+        assert(first <= (int)objects_shading.size());
+        const std::vector<ObjectPrototype> &pp = protos_prev.size() > 0 ? protos_prev : protos;
+        assert(pp.size() == protos.size());
+        size_t count = std::max(objects_shading.size(), first + protos.size());
+        objects_shading.resize(count);
+        objects_shading_prev.resize(count);
+        for (size_t i = 0; i < protos.size(); ++i) {
+            pack_object_prototype(&objects_shading[first + i], &protos[i]);
+            pack_object_prototype(&objects_shading_prev[first + i], &pp[i]);
+        }
+    }
+
+    // Only bounded objects are in the hierarchy, see `Renderer::update_scene`.
+    const int segments = trace_config.motion_segments;
+    std::vector<Moebius> maps;
+    size_t count = std::max(objects_geometry.size(), first + insts.size());
+    bool rebuild = count > objects_geometry.size();
+    objects_geometry.resize(count);
+    objects_motion.resize(count*segments);
+    objects_mask.resize(count);
+    instances.resize(count);
+    instances_mask.resize(count, false);
+    for (size_t i = 0; i < insts.size(); ++i) {
+        assert(insts[i].prototype >= 0 && insts[i].prototype < (int)objects_shading.size());
+        assert(insts[i].group < (int)groups.size());
+        size_t j = first + i;
+        rebuild = rebuild ||
+            Bvh::is_bounded(instances[j], instances_mask[j]) ||
+            Bvh::is_bounded(insts[i], insts_mask[i]);
+        pack_object_instance(&objects_geometry[j], &insts[i]);
+        maps.clear();
+        for (const std::vector<ObjectInstance> &frame : insts_keyframes) {
+            assert(frame.size() == insts.size());
+            maps.push_back(frame[i].map);
+        }
+        maps.push_back(insts[i].map);
+        maps = resample_keyframes(maps, segments + 1, mo_interpolate);
+        for (int k = 0; k < segments; ++k) {
+            objects_motion[j*segments + k] = mo_path_pack(mo_path_new(maps[k], maps[k + 1]));
+        }
+        objects_mask[j] = (uchar_pk)insts_mask[i];
+        instances[j] = insts[i];
+        instances_mask[j] = insts_mask[i];
+    }
+
+    if (rebuild) {
+        bvh = Bvh(instances, instances_mask);
+    }
+}
+
+void CpuRenderer::store_groups(const std::vector<Group> &grps) {
+    groups.resize(grps.size());
+    for (size_t i = 0; i < grps.size(); ++i) {
+        // Every face must have the paired one, see `group_prepare`.
+        for (int k = 0; k < grps[i].count; ++k) {
+            assert(grps[i].inverse[k] >= 0 && grps[i].inverse[k] < grps[i].count);
+        }
+        pack_group(&groups[i], &grps[i]);
+    }
+}
+
+void CpuRenderer::load_image(uint8_t *data) {
+    std::copy(image.begin(), image.end(), data);
+}
+
+const uint8_t *CpuRenderer::image_data() const {
+    return image.data();
+}
+
+void CpuRenderer::set_view(const View &v) {
+    set_view(v, v);
+}
+void CpuRenderer::set_view(const View &v, const View &vp) {
+    set_view(v, std::vector<View>{vp});
+}
+void CpuRenderer::set_view(const View &v, const std::vector<View> &keyframes) {
+    view = v;
+    std::vector<View> views(keyframes);
+    views.push_back(v);
+    views = resample_keyframes(views, trace_config.motion_segments + 1, view_interpolate);
+    view_motion.resize(views.size() - 1);
+    for (size_t k = 0; k + 1 < views.size(); ++k) {
+        view_motion[k] = view_motion_pack(view_motion_new(views[k], views[k + 1]));
+    }
+}
+
+void CpuRenderer::render_tile(int tile, int count) {
+    int tiles_x = (width + TILE_SIZE - 1)/TILE_SIZE;
+    int x0 = (tile % tiles_x)*TILE_SIZE, y0 = (tile/tiles_x)*TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, width), y1 = std::min(y0 + TILE_SIZE, height);
+
+    Scene scene;
+    scene.geometry = objects_geometry.data();
+    scene.motion = objects_motion.data();
+    scene.motion_segments = trace_config.motion_segments;
+    scene.shading = objects_shading.data();
+    scene.shading_prev = objects_shading_prev.data();
+    scene.objects_mask = objects_mask.data();
+    scene.object_count = (int)objects_geometry.size();
+    scene.bvh_nodes = bvh.nodes.data();
+    scene.bvh_indices = bvh.indices.data();
+    scene.bvh_node_count = (int)bvh.nodes.size();
+    scene.bvh_unbounded_count = bvh.unbounded_count;
+    scene.groups = groups.data();
+
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            int idx = x + y*width;
+            float3 avg_color = float3::load(&screen[3*idx]);
+            for (int i = 0; i < count; ++i) {
+                int sample_no = monte_carlo_counter + i;
+                Rng rng;
+                rand_init(&rng, idx, frame_counter, sample_no, 0, trace_config.low_discrepancy);
+                float3 color = trace_sample(
+                    &scene, &trace_config, &rng,
+                    view, view_motion.data(),
+                    make_int2(x, y), make_int2(width, height),
+                    nullptr, nullptr
+                );
+                avg_color = (color + avg_color*(float)sample_no)/(float)(sample_no + 1);
+            }
+            avg_color.store(&screen[3*idx]);
+
+            for (int j = 0; j < 3; ++j) {
+                float c = clamp(avg_color[j], 0.0f, 1.0f);
+                if (fabs(gamma - 1.0) > EPS) {
+                    c = pow(c, float(1.0/gamma));
+                }
+                image[4*idx + j] = (uint8_t)(255*c);
+            }
+            image[4*idx + 3] = 0xff;
+        }
+    }
+}
+
+void CpuRenderer::render(bool fresh) {
+    render_n(1, fresh);
+}
+
+int CpuRenderer::render_n(int n, bool fresh) {
+    if (fresh) {
+        monte_carlo_counter = 0;
+        frame_counter += 1;
+    }
+
+    int tiles_x = (width + TILE_SIZE - 1)/TILE_SIZE;
+    int tiles_y = (height + TILE_SIZE - 1)/TILE_SIZE;
+    pool.run(tiles_x*tiles_y, [this, n](int tile, int worker) {
+        render_tile(tile, n);
+    });
+
+    monte_carlo_counter += n;
+    return n;
+}
+
+int CpuRenderer::render_for(double sec, bool fresh) {
+    const duration render_time(sec);
+
+    int sample_counter = 0;
+    auto start = std::chrono::system_clock::now();
+    do {
+        sample_counter += render_n(samples_per_launch, fresh);
+        fresh = false;
+    } while(std::chrono::system_clock::now() - start < render_time);
+
+    return sample_counter;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <renderer.hpp>
+#include <cpu/pool.hpp>
+#include <bvh.hpp>
+
+#include <view.hh>
+#include <object.hh>
+#include <group.hh>
+#include <trace.hh>
+
+
+// Renders the scene on the host processor with the same path tracing code
+// the device kernel uses. The image is split into square tiles which are
+// distributed between the threads of the pool.
+class CpuRenderer {
+    public:
+    typedef Renderer::Config Config;
+
+    static const int TILE_SIZE = 16;
+
+    private:
+    int width, height;
+
+    TraceConfig trace_config;
+    double gamma;
+    // Samples per pixel of a pass of the pool in `render_for`.
+    int samples_per_launch;
+
+    cpu::Pool pool;
+
+    std::vector<uint8_t> image;
+    std::vector<float> screen;
+
+    std::vector<ObjectGeometryPk> objects_geometry;
+    std::vector<MoebiusPathPk> objects_motion;
+    std::vector<ObjectShadingPk> objects_shading;
+    std::vector<ObjectShadingPk> objects_shading_prev;
+    std::vector<uchar_pk> objects_mask;
+
+    std::vector<ObjectInstance> instances;
+    std::vector<bool> instances_mask;
+
+    Bvh bvh;
+
+    std::vector<GroupPk> groups;
+
+    int monte_carlo_counter = 0;
+    // Advanced by every fresh image, see `Renderer`.
+    int frame_counter = 0;
+
+    View view;
+    std::vector<ViewMotionPk> view_motion;
+
+    void render_tile(int tile, int count);
+
+    void store_scene(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectPrototype> &protos_prev,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
+    );
+    void update_scene(
+        int first,
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectPrototype> &protos_prev,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
+    );
+
+    public:
+    // Zero `thread_count` means all hardware threads.
+    CpuRenderer(
+        int width, int height,
+        const Config &config,
+        int thread_count=0
+    );
+
+    void store_objects(const std::vector<Object> &objs);
+    void store_objects(
+        const std::vector<Object> &objs,
+        const std::vector<Object> &objs_prev,
+        const std::vector<bool> &objs_mask
+    );
+    void store_objects(
+        const std::vector<Object> &objs,
+        const std::vector<std::vector<Object>> &objs_keyframes,
+        const std::vector<bool> &objs_mask
+    );
+    void store_objects(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectInstance> &insts
+    );
+    void store_objects(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<ObjectInstance> &insts_prev,
+        const std::vector<bool> &insts_mask
+    );
+    void store_objects(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
+    );
+    void update_objects(
+        int first,
+        const std::vector<Object> &objs,
+        const std::vector<Object> &objs_prev,
+        const std::vector<bool> &objs_mask
+    );
+    void update_objects(
+        int first,
+        const std::vector<Object> &objs,
+        const std::vector<std::vector<Object>> &objs_keyframes,
+        const std::vector<bool> &objs_mask
+    );
+    void update_objects(
+        int first,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<ObjectInstance> &insts_prev,
+        const std::vector<bool> &insts_mask
+    );
+    void update_objects(
+        int first,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
+    );
+    void store_groups(const std::vector<Group> &grps);
+
+    void load_image(uint8_t *data);
+    const uint8_t *image_data() const;
+
+    void set_view(const View &v);
+    void set_view(const View &v, const View &vp);
+    void set_view(const View &v, const std::vector<View> &keyframes);
+
+    void render(bool fresh);
+    int render_n(int count, bool fresh);
+    int render_for(double sec, bool fresh);
+};
@@ -0,0 +1,93 @@
+#include "encoder.hpp"
+
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+
+#include <sdl/image.hpp>
+#include <exr.hpp>
+
+
+static bool ends_with(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() &&
+        str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool Encoder::is_hdr(const std::string &filename) {
+    return ends_with(filename, ".exr");
+}
+
+bool Encoder::write(const Image &image) {
+    if (is_hdr(image.filename)) {
+        assert(image.hdr_data.size() == 3*size_t(image.width*image.height));
+        return save_exr(image.filename, image.width, image.height, image.hdr_data.data());
+    } else if (ends_with(image.filename, ".png")) {
+        assert(image.data.size() == 4*size_t(image.width*image.height));
+        return sdl::save_image(image.filename, image.width, image.height, image.data.data());
+    } else {
+        return false;
+    }
+}
+
+Encoder::Encoder(int thread_count, int queue_max) :
+    queue_max(std::max(1, queue_max))
+{
+    if (thread_count <= 0) {
+        thread_count = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        threads.push_back(std::thread([this]() { loop(); }));
+    }
+}
+Encoder::~Encoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    pop_cv.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void Encoder::loop() {
+    for (;;) {
+        Image image;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pop_cv.wait(lock, [this]() { return stop || !queue.empty(); });
+            // Remaining images are still written on stop.
+            if (queue.empty()) {
+                return;
+            }
+            image = std::move(queue.front());
+            queue.pop_front();
+            busy += 1;
+        }
+        push_cv.notify_all();
+
+        if (!write(image)) {
+            std::cerr << "Cannot write image " << image.filename << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy -= 1;
+        }
+        push_cv.notify_all();
+    }
+}
+
+void Encoder::push(Image image) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        push_cv.wait(lock, [this]() { return queue.size() < queue_max; });
+        queue.push_back(std::move(image));
+    }
+    pop_cv.notify_one();
+}
+
+void Encoder::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    push_cv.wait(lock, [this]() { return queue.empty() && busy == 0; });
+}
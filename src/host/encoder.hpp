@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+
+// Writes images to files in background threads, so that rendering
+// of the next frame doesn't wait for compression of the previous one.
+class Encoder {
+    public:
+    // File format is chosen by the extension of `filename`:
+    // `.png` is written from 8-bit RGBA `data`,
+    // `.exr` is written from linear RGB `hdr_data`.
+    struct Image {
+        std::string filename;
+        int width = 0, height = 0;
+        std::vector<uint8_t> data;
+        std::vector<float> hdr_data;
+    };
+
+    static bool is_hdr(const std::string &filename);
+    static bool write(const Image &image);
+
+    private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable push_cv, pop_cv;
+    std::deque<Image> queue;
+    size_t queue_max;
+    int busy = 0;
+    bool stop = false;
+
+    void loop();
+
+    public:
+    // Zero `thread_count` means the number of hardware threads.
+    // `push` blocks while there are `queue_max` images waiting.
+    Encoder(int thread_count=0, int queue_max=4);
+    ~Encoder();
+
+    Encoder(const Encoder &other) = delete;
+    Encoder &operator=(const Encoder &other) = delete;
+
+    void push(Image image);
+    // Blocks until all pushed images are written.
+    void wait();
+};
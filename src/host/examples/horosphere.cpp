@@ -25,7 +25,6 @@
 
 class MyScenario : public PathScenario {
     private:
-    std::vector<Object> objects;
     std::vector<double> ts; // timestamps
 
     template <typename Tr>
@@ -34,27 +33,30 @@ class MyScenario : public PathScenario {
     }
 
     public:
+    ObjectTrack track;
+
     MyScenario() {
-        objects = {
-            Object{
-                .type = OBJECT_HOROSPHERE,
-                .map = mo_identity(),
-                .materials = {
-                    Material {make_color(0x6ec3c1), 0.0, 0.0, float3(0)},
-                    Material {make_color(0x335120), 0.0, 0.0, float3(0)},
-                    Material {make_color(0x9dcc5f), 0.0, 0.0, float3(0)},
-                    Material {make_color(0x0d5f8a), 0.0, 0.0, float3(0)},
-                },
-                .material_count = 4,
-                .tiling = {
-                    .type = HOROSPHERE_TILING_SQUARE,
-                    .cell_size = 0.25,
-                    .border_width = 0.03,
-                    .border_material = Material {float3(0.0), 0.0, 0, float3(0)},
-                },
-            }
+        Object object {
+            .type = OBJECT_HOROSPHERE,
+            .map = mo_identity(),
+            .materials = {
+                Material {make_color(0x6ec3c1), 0.0, 0.0, float3(0)},
+                Material {make_color(0x335120), 0.0, 0.0, float3(0)},
+                Material {make_color(0x9dcc5f), 0.0, 0.0, float3(0)},
+                Material {make_color(0x0d5f8a), 0.0, 0.0, float3(0)},
+            },
+            .material_count = 4,
+            .tiling = {
+                .type = HOROSPHERE_TILING_SQUARE,
+                .p = 0, .q = 0,
+                .cell_size = 0.25,
+                .border_width = 0.03,
+                .border_material = Material {float3(0.0), 0.0, 0, float3(0)},
+                .edge = 0.0,
+                .rotation = C1,
+            },
         };
-        
+
         ts = {
             0.0, // Move
             5.0, // Become transparent
@@ -77,20 +79,23 @@ class MyScenario : public PathScenario {
         add_any(LinearTransition(ts[3] - ts[2], points[1], points[2]));
         add_any(SquareTransition(ts[4] - ts[3], points[2], points[3], 0.0, 1.0));
         add_any(SquareTransition(ts[5] - ts[4], points[3], points[4], 0.0, 1.0));
+
+        // Becomes transparent, then the tiling is resized.
+        const auto key = [&](double t, real tr, real cs) {
+            Object obj(object);
+            for (int i = 0; i < obj.material_count; ++i) {
+                obj.materials[i].transparency = tr;
+            }
+            obj.tiling.cell_size = cs;
+            obj.tiling.border_width = 0.1*cs;
+            track.add_key(t, obj);
+        };
+        key(ts[1], 0.0, 0.25);
+        key(ts[2], 0.5, 0.25);
+        key(ts[3], 0.5, 0.75);
     }
     virtual std::vector<Object> get_objects(double t) const {
-        std::vector<Object> objs(objects);
-
-        real tr = 0.5*(1.0 - clamp((ts[2] - t)/(ts[2] - ts[1]), 0.0, 1.0));
-        for (int i = 0; i < objs[0].material_count; ++i) {
-            objs[0].materials[i].transparency = tr;
-        }
-
-        real cs = 0.25 + 0.5*clamp((t - ts[2])/(ts[3] - ts[2]), 0.0, 1.0);
-        objs[0].tiling.cell_size = cs;
-        objs[0].tiling.border_width = 0.1*cs;
-
-        return objs;
+        return std::vector<Object>{track.get_object(t)};
     }
 };
 
@@ -132,6 +137,7 @@ int main(int argc, const char *argv[]) {
     int counter = 0;
     double time = 0.0;
     double frame_time = 0.04;//0.05/3;
+    renderer.store_tracks({scenario.track});
     duration time_counter;
     int sample_counter = 0;
     for(;;) {
@@ -141,23 +147,17 @@ int main(int argc, const char *argv[]) {
             scenario.get_view(time),
             scenario.get_view(time - frame_time)
         );
-        renderer.store_objects(
-            scenario.get_objects(time),
-            scenario.get_objects(time - frame_time),
-            std::vector<bool>{true}
-        );
+        renderer.set_time(time, frame_time);
         sample_counter += renderer.render_for(frame_time, true);
+        renderer.swap_image();
         //sample_counter += renderer.render_n(200, true);
         time += frame_time;
 
-        auto store = [&](uint8_t *data) {
-            renderer.load_image(data);
-        };
-        viewer.display(store);
+        viewer.display(renderer.image_data());
 
         //std::stringstream ss;
         //ss << std::setfill('0') << std::setw(5) << "output/" << counter << ".png";
-        //sdl::save_image(ss.str(), width, height, store);
+        //sdl::save_image(ss.str(), width, height, renderer.image_data());
 
         if (!controller.handle() || time > scenario.duration()) {
             break;
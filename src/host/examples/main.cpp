@@ -45,7 +45,11 @@ int main(int argc, const char *argv[]) {
         .path_max_depth = 3,
         .path_max_diffuse_depth = 2,
         .blur = { .lens = true, .motion = true, .object_motion = false },
-        .gamma = 2.2
+        .gamma = 2.2,
+        // Accumulated passes are shown band by band.
+        .tiled = { .enabled = true },
+        // Camera motion reprojects the accumulated samples.
+        .temporal = { .enabled = true }
     });
     renderer.store_objects(create_scene());
 
@@ -63,27 +67,32 @@ int main(int argc, const char *argv[]) {
 
     duration time_counter;
     int sample_counter = 0;
-    int refresh = 1;
+    bool moving = false;
     for(;;) {
         duration elapsed;
         auto start = std::chrono::system_clock::now();
 
+        int w, h;
+        if (viewer.window_resized(&w, &h)) {
+            viewer.resize(w, h);
+            renderer.resize(w, h);
+        }
+
+        // The previous frame is read back and presented
+        // while the device renders the current one.
+        renderer.swap_image();
         renderer.set_view(controller.view, controller.view_prev);
-        sample_counter += renderer.render_for(0.04, refresh > 0);
+        // Quarter of the pixels are traced while the camera moves.
+        renderer.set_render_scale(moving ? 0.5 : 1.0);
+        sample_counter += renderer.render_for(0.04, false);
 
-        viewer.display([&](uint8_t *data) {
-            renderer.load_image(data);
-        });
+        viewer.display(renderer.image_data());
         if (!controller.handle()) {
             break;
         }
 
         elapsed = std::chrono::system_clock::now() - start;
-        if (controller.step(elapsed.count())) {
-            refresh = 2;
-        } else if (refresh > 0) {
-            refresh -= 1;
-        }
+        moving = controller.step(elapsed.count());
         
         time_counter += elapsed;
         if (time_counter.count() > 1.0) {
@@ -92,6 +101,14 @@ int main(int argc, const char *argv[]) {
 
             std::cout << "Samples per second: " <<
                 sample_counter/time_counter.count() << std::endl;
+
+            Renderer::Stats stats = renderer.take_stats();
+            std::cout << "Device time: kernels " << stats.kernel_time <<
+                " s, transfers " << stats.transfer_time << " s" << std::endl;
+            if (stats.rays > 0) {
+                std::cout << "Rays per second: " << stats.rays_per_second() <<
+                    ", bounces per second: " << stats.bounces_per_second() << std::endl;
+            }
             time_counter = duration(0.0);
             sample_counter = 0;
         }
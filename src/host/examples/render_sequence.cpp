@@ -0,0 +1,135 @@
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencl/search.hpp>
+#include <renderer.hpp>
+#include <sequence.hpp>
+
+#include "replay.hpp"
+
+
+// Renders the replay scenario to image files without opening a window.
+static void usage() {
+    std::cerr <<
+        "Usage: render_sequence [options]\n"
+        "  --device <platform-no> <device-no>\n"
+        "  --size <width>x<height>      (default 1280x720)\n"
+        "  --fps <frame-rate>           (default 25)\n"
+        "  --keyframes <count>          motion blur keyframes per frame (default 2)\n"
+        "  --frames <first>:<last>      render frames [first, last)\n"
+        "  --part <k>/<n>               render only k-th of n parts of the range\n"
+        "  --samples <count>            samples per pixel (default 256)\n"
+        "  --noise <threshold>          sample until the noise is below threshold\n"
+        "  --max-samples <count>        limit of samples with --noise (default 4096)\n"
+        "  --samples-per-launch <count> samples per kernel launch, or 'auto' (default 1)\n"
+        "  --output <pattern>           like output/%05d.png or output/%05d.exr\n"
+        "  --skip-existing              don't render frames which files exist\n"
+        "  --encoder-threads <count>\n"
+        "  --wavefront                  use wavefront path tracer\n"
+        "  --adaptive <threshold>       sample only pixels with error above threshold\n";
+}
+
+int main(int argc, const char *argv[]) {
+    int platform_no = 0;
+    int device_no = 0;
+    int width = 1280, height = 720;
+    bool wavefront = false;
+    double adaptive_threshold = 0.0;
+    // Zero means fitting the number to the launch time.
+    int samples_per_launch = 1;
+    SequenceConfig config;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(arg);
+                }
+                return std::string(argv[++i]);
+            };
+            if (arg == "--device") {
+                platform_no = std::stoi(next());
+                device_no = std::stoi(next());
+            } else if (arg == "--size") {
+                if (sscanf(next().c_str(), "%dx%d", &width, &height) != 2) {
+                    throw std::invalid_argument(arg);
+                }
+            } else if (arg == "--fps") {
+                config.frame_rate = std::stod(next());
+            } else if (arg == "--keyframes") {
+                config.keyframes = std::stoi(next());
+            } else if (arg == "--frames") {
+                if (sscanf(next().c_str(), "%d:%d", &config.first, &config.last) != 2) {
+                    throw std::invalid_argument(arg);
+                }
+            } else if (arg == "--part") {
+                if (sscanf(next().c_str(), "%d/%d", &config.part, &config.part_count) != 2) {
+                    throw std::invalid_argument(arg);
+                }
+            } else if (arg == "--samples") {
+                config.samples = std::stoi(next());
+            } else if (arg == "--noise") {
+                config.noise = std::stod(next());
+            } else if (arg == "--max-samples") {
+                config.max_samples = std::stoi(next());
+            } else if (arg == "--samples-per-launch") {
+                std::string value = next();
+                samples_per_launch = value == "auto" ? 0 : std::stoi(value);
+            } else if (arg == "--output") {
+                config.output = next();
+            } else if (arg == "--skip-existing") {
+                config.skip_existing = true;
+            } else if (arg == "--encoder-threads") {
+                config.encoder_threads = std::stoi(next());
+            } else if (arg == "--wavefront") {
+                wavefront = true;
+            } else if (arg == "--adaptive") {
+                adaptive_threshold = std::stod(next());
+            } else {
+                throw std::invalid_argument(arg);
+            }
+        }
+        if (
+            width <= 0 || height <= 0 || config.frame_rate <= 0.0 ||
+            config.part_count <= 0 || config.part < 0 || config.part >= config.part_count ||
+            config.samples <= 0 || config.keyframes < 2 || samples_per_launch < 0 ||
+            !is_frame_pattern(config.output) ||
+            (wavefront && adaptive_threshold > 0.0)
+        ) {
+            throw std::invalid_argument("");
+        }
+    } catch(...) {
+        std::cerr << "Invalid argument" << std::endl;
+        usage();
+        return 1;
+    }
+
+    std::cout << "Using platform " << platform_no << ", device " << device_no << std::endl;
+    cl_device_id device = cl::search_device(platform_no, device_no);
+
+    Renderer::Config renderer_config {
+        .path_max_depth = 3,
+        .path_max_diffuse_depth = 2,
+        .blur = { .lens = true, .motion = true, .object_motion = true },
+        .gamma = 2.2
+    };
+    renderer_config.blur.keyframes = config.keyframes;
+    renderer_config.wavefront = wavefront;
+    renderer_config.batch.samples_per_launch = std::max(samples_per_launch, 1);
+    renderer_config.batch.auto_tune = samples_per_launch == 0;
+    if (adaptive_threshold > 0.0) {
+        renderer_config.adaptive.enabled = true;
+        renderer_config.adaptive.threshold = adaptive_threshold;
+    }
+    Renderer renderer(device, width, height, renderer_config);
+
+    ReplayScenario scenario;
+    int count = render_sequence(renderer, width, height, scenario, config);
+    std::cout << count << " frames written" << std::endl;
+
+    return 0;
+}
@@ -24,18 +24,11 @@
 #include <scenario.hpp>
 #include <color.hpp>
 
-#include "scene.hpp"
+#include "replay.hpp"
 
 
 using duration = std::chrono::duration<double>;
 
-class MyScenario : public PathScenario {
-    public:
-    std::vector<Object> get_objects(double t) const override {
-        return std::vector<Object>();
-    }
-};
-
 int main(int argc, const char *argv[]) {
     int platform_no = 0;
     int device_no = 0;
@@ -66,50 +59,7 @@ int main(int argc, const char *argv[]) {
     Viewer viewer(width, height);
     Controller controller;
 
-    std::vector<View> points {
-        view_position(mo_new(
-            c_new(0.0704422, 0.388156),
-            c_new(3.25709, -0.644618),
-            c_new(0.0280217, 0.0111143),
-            c_new(0.542426, -2.73144)
-        )),
-        view_position(mo_new(
-            c_new(0.0286821, 0.683827),
-            c_new(2.8249, -1.7697),
-            c_new(-0.0203855, 0.451223),
-            c_new(2.02, -2.46116)
-        )),
-        view_position(mo_new(
-            c_new(0.605603, -0.0125093),
-            c_new(1.13499, -2.28722),
-            c_new(0.296042, -0.0701192),
-            c_new(1.96622, -1.20888)
-        )),
-        view_position(mo_new(
-            c_new(0.155695, -0.546314),
-            c_new(-1.72239, -0.323492),
-            c_new(-0.0113209, -0.0551297),
-            c_new(0.316326, 1.74335)
-        )),
-        view_position(mo_new(
-            c_new(0.0748133, -0.111905),
-            c_new(-5.96229, 0.107037),
-            c_new(0.0470794, -0.0507573),
-            c_new(1.09217, 5.74615)
-        )),
-    };
-    
-    MyScenario scenario;
-    std::vector<SquareTransition> transitions {
-        SquareTransition(8.0, points[0], points[1], 0.0, 1.0),
-        SquareTransition(8.0, points[1], points[2], 0.0, 1.0),
-        SquareTransition(8.0, points[2], points[3], 0.0, 1.0),
-        SquareTransition(8.0, points[3], points[4], 0.0, 1.0)
-    };
-    
-    for (const auto &t : transitions) {
-        scenario.add_transition(std::make_unique<SquareTransition>(t));
-    }
+    ReplayScenario scenario;
 
     //controller.view.lens_radius = 1e-1;
 
@@ -127,17 +77,15 @@ int main(int argc, const char *argv[]) {
             scenario.get_view(time - frame_time)
         );
         sample_counter += renderer.render_for(frame_time, true);
+        renderer.swap_image();
         //sample_counter += renderer.render_n(100, true);
         time += frame_time;
 
-        auto store = [&](uint8_t *data) {
-            renderer.load_image(data);
-        };
-        viewer.display(store);
+        viewer.display(renderer.image_data());
 
         //std::stringstream ss;
         //ss << std::setfill('0') << std::setw(5) << "output/" << counter << ".png";
-        //sdl::save_image(ss.str(), width, height, store);
+        //sdl::save_image(ss.str(), width, height, renderer.image_data());
 
         if (!controller.handle() || time > scenario.duration()) {
             break;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include <algebra/moebius.hh>
+#include <view.hh>
+#include <object.hh>
+
+#include <scenario.hpp>
+
+#include "scene.hpp"
+
+
+// Camera flight over the static scene from `scene.hpp`.
+class ReplayScenario : public PathScenario {
+    public:
+    ReplayScenario() {
+        std::vector<View> points {
+            view_position(mo_new(
+                c_new(0.0704422, 0.388156),
+                c_new(3.25709, -0.644618),
+                c_new(0.0280217, 0.0111143),
+                c_new(0.542426, -2.73144)
+            )),
+            view_position(mo_new(
+                c_new(0.0286821, 0.683827),
+                c_new(2.8249, -1.7697),
+                c_new(-0.0203855, 0.451223),
+                c_new(2.02, -2.46116)
+            )),
+            view_position(mo_new(
+                c_new(0.605603, -0.0125093),
+                c_new(1.13499, -2.28722),
+                c_new(0.296042, -0.0701192),
+                c_new(1.96622, -1.20888)
+            )),
+            view_position(mo_new(
+                c_new(0.155695, -0.546314),
+                c_new(-1.72239, -0.323492),
+                c_new(-0.0113209, -0.0551297),
+                c_new(0.316326, 1.74335)
+            )),
+            view_position(mo_new(
+                c_new(0.0748133, -0.111905),
+                c_new(-5.96229, 0.107037),
+                c_new(0.0470794, -0.0507573),
+                c_new(1.09217, 5.74615)
+            )),
+        };
+
+        std::vector<SquareTransition> transitions {
+            SquareTransition(8.0, points[0], points[1], 0.0, 1.0),
+            SquareTransition(8.0, points[1], points[2], 0.0, 1.0),
+            SquareTransition(8.0, points[2], points[3], 0.0, 1.0),
+            SquareTransition(8.0, points[3], points[4], 0.0, 1.0)
+        };
+
+        for (const auto &t : transitions) {
+            add_transition(std::make_unique<SquareTransition>(t));
+        }
+    }
+
+    std::vector<Object> get_objects(double t) const override {
+        return create_scene();
+    }
+};
@@ -23,9 +23,12 @@ std::vector<Object> create_scene() {
             .material_count = 3,
             .tiling = {
                 .type = HOROSPHERE_TILING_HEXAGONAL,
+                .p = 0, .q = 0,
                 .cell_size = 0.5,
                 .border_width = 0.02,
                 .border_material = Material {border_color, 0.0, 0, float3(1.0)},
+                .edge = 0.0,
+                .rotation = C1,
             },
         },
         Object{
@@ -40,9 +43,12 @@ std::vector<Object> create_scene() {
             .material_count = 4,
             .tiling = {
                 .type = HOROSPHERE_TILING_SQUARE,
+                .p = 0, .q = 0,
                 .cell_size = 0.5,
                 .border_width = 0.02,
                 .border_material = Material {border_color, 0.0, 0, float3(1.0)},
+                .edge = 0.0,
+                .rotation = C1,
             },
         },
         Object{
@@ -55,9 +61,12 @@ std::vector<Object> create_scene() {
             .material_count = 2,
             .tiling = {
                 .type = HYPLANE_TILING_PENTASTAR,
+                .p = 0, .q = 0,
                 .cell_size = 0.5,
                 .border_width = 0.01,
                 .border_material = Material {border_color, 0.0, 0, float3(1.0)},
+                .edge = 0.0,
+                .rotation = C1,
             },
         },
         Object{
@@ -70,9 +79,12 @@ std::vector<Object> create_scene() {
             .material_count = 2,
             .tiling = {
                 .type = HYPLANE_TILING_PENTAGONAL,
+                .p = 0, .q = 0,
                 .cell_size = 0.95,
                 .border_width = 0.02,
                 .border_material = Material {border_color, 0.0, 0, float3(1.0)},
+                .edge = 0.0,
+                .rotation = C1,
             },
         },
     };
@@ -0,0 +1,110 @@
+#include "exr.hpp"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+
+namespace {
+    class ExrWriter {
+        public:
+        std::vector<uint8_t> data;
+
+        void u8(uint8_t v) {
+            data.push_back(v);
+        }
+        void i32(int32_t v) {
+            for (int i = 0; i < 4; ++i) {
+                u8((uint8_t)((uint32_t)v >> (8*i)));
+            }
+        }
+        void u64(uint64_t v) {
+            for (int i = 0; i < 8; ++i) {
+                u8((uint8_t)(v >> (8*i)));
+            }
+        }
+        void f32(float v) {
+            uint32_t u;
+            memcpy(&u, &v, sizeof(u));
+            i32((int32_t)u);
+        }
+        void str(const char *s) {
+            while (*s != '\0') {
+                u8((uint8_t)*s++);
+            }
+            u8(0);
+        }
+        void attr(const char *name, const char *type, int size) {
+            str(name);
+            str(type);
+            i32(size);
+        }
+    };
+}
+
+bool save_exr(const std::string &filename, int width, int height, const float *rgb) {
+    // Channels are stored in alphabetical order.
+    const char *channels[3] = {"B", "G", "R"};
+    const int channel_offset[3] = {2, 1, 0};
+    const int float_type = 2;
+
+    ExrWriter w;
+    w.i32(20000630);
+    w.i32(2);
+
+    w.attr("channels", "chlist", 3*(2 + 16) + 1);
+    for (const char *c : channels) {
+        w.str(c);
+        w.i32(float_type);
+        w.i32(0); // pLinear and reserved
+        w.i32(1); // xSampling
+        w.i32(1); // ySampling
+    }
+    w.u8(0);
+
+    w.attr("compression", "compression", 1);
+    w.u8(0);
+
+    w.attr("dataWindow", "box2i", 16);
+    w.i32(0); w.i32(0); w.i32(width - 1); w.i32(height - 1);
+    w.attr("displayWindow", "box2i", 16);
+    w.i32(0); w.i32(0); w.i32(width - 1); w.i32(height - 1);
+
+    w.attr("lineOrder", "lineOrder", 1);
+    w.u8(0);
+
+    w.attr("pixelAspectRatio", "float", 4);
+    w.f32(1.0f);
+    w.attr("screenWindowCenter", "v2f", 8);
+    w.f32(0.0f); w.f32(0.0f);
+    w.attr("screenWindowWidth", "float", 4);
+    w.f32(1.0f);
+
+    w.u8(0);
+
+    // Every uncompressed chunk holds a single scanline.
+    const int line_size = 3*width*(int)sizeof(float);
+    uint64_t offset = w.data.size() + 8*(uint64_t)height;
+    for (int y = 0; y < height; ++y) {
+        w.u64(offset);
+        offset += 8 + line_size;
+    }
+    for (int y = 0; y < height; ++y) {
+        w.i32(y);
+        w.i32(line_size);
+        for (int c = 0; c < 3; ++c) {
+            for (int x = 0; x < width; ++x) {
+                w.f32(rgb[3*(x + y*width) + channel_offset[c]]);
+            }
+        }
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.write((const char *)w.data.data(), w.data.size());
+    return (bool)file;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+
+// Writes linear RGB image (3 floats per pixel, rows from top to bottom)
+// to uncompressed single-part scanline OpenEXR file.
+bool save_exr(const std::string &filename, int width, int height, const float *rgb);
@@ -1,7 +1,18 @@
 #include <memory>
 #include <iostream>
+#include <fstream>
 #include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdint>
 #include <cassert>
+#include <algorithm>
+#include <random>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 #include "opencl.hpp"
 
@@ -18,8 +29,11 @@ cl::Context::operator cl_context() const {
     return context;
 }
 
-cl::Queue::Queue(cl_context context, cl_device_id device) {
-    queue = clCreateCommandQueue(context, device, 0, nullptr);
+cl::Queue::Queue(
+    cl_context context, cl_device_id device,
+    cl_command_queue_properties properties
+) {
+    queue = clCreateCommandQueue(context, device, properties, nullptr);
     assert(queue != nullptr);
 }
 cl::Queue::~Queue() {
@@ -28,6 +42,217 @@ cl::Queue::~Queue() {
 cl::Queue::operator cl_command_queue() const {
     return queue;
 }
+void cl::Queue::flush() {
+    assert(clFlush(queue) == CL_SUCCESS);
+}
+void cl::Queue::finish() {
+    assert(clFinish(queue) == CL_SUCCESS);
+}
+
+cl::Event::Event() {
+    event = nullptr;
+}
+cl::Event::~Event() {
+    release();
+}
+cl::Event::Event(cl::Event &&other) {
+    event = other.event;
+    other.event = nullptr;
+}
+cl::Event &cl::Event::operator=(cl::Event &&other) {
+    if (this != &other) {
+        release();
+        event = other.event;
+        other.event = nullptr;
+    }
+    return *this;
+}
+
+cl::Event cl::Event::clone() const {
+    Event other;
+    if (event != nullptr) {
+        assert(clRetainEvent(event) == CL_SUCCESS);
+        other.event = event;
+    }
+    return other;
+}
+
+cl_event &cl::Event::raw() {
+    return event;
+}
+const cl_event &cl::Event::raw() const {
+    return event;
+}
+cl::Event::operator cl_event() const {
+    return event;
+}
+bool cl::Event::empty() const {
+    return event == nullptr;
+}
+
+bool cl::Event::completed() const {
+    if (event == nullptr) {
+        return true;
+    }
+    cl_int status = CL_COMPLETE;
+    assert(clGetEventInfo(
+        event, CL_EVENT_COMMAND_EXECUTION_STATUS,
+        sizeof(cl_int), &status, nullptr
+    ) == CL_SUCCESS);
+    // Negative status means abnormal termination, the command won't run anymore.
+    return status <= CL_COMPLETE;
+}
+void cl::Event::wait() const {
+    if (event != nullptr) {
+        assert(clWaitForEvents(1, &event) == CL_SUCCESS);
+    }
+}
+void cl::Event::release() {
+    if (event != nullptr) {
+        assert(clReleaseEvent(event) == CL_SUCCESS);
+        event = nullptr;
+    }
+}
+
+double cl::Event::duration() const {
+    if (event == nullptr) {
+        return 0.0;
+    }
+    cl_ulong start = 0, end = 0;
+    assert(clGetEventProfilingInfo(
+        event, CL_PROFILING_COMMAND_START,
+        sizeof(cl_ulong), &start, nullptr
+    ) == CL_SUCCESS);
+    assert(clGetEventProfilingInfo(
+        event, CL_PROFILING_COMMAND_END,
+        sizeof(cl_ulong), &end, nullptr
+    ) == CL_SUCCESS);
+    return end > start ? 1e-9*(end - start) : 0.0;
+}
+
+// Empty events are already completed, so they are dropped from wait lists.
+static std::vector<cl_event> filter_events(const std::vector<cl_event> &events) {
+    std::vector<cl_event> list;
+    for (cl_event e : events) {
+        if (e != nullptr) {
+            list.push_back(e);
+        }
+    }
+    return list;
+}
+
+static std::string device_info_string(cl_device_id device, cl_device_info param) {
+    size_t size = 0;
+    assert(clGetDeviceInfo(device, param, 0, nullptr, &size) == CL_SUCCESS);
+    std::vector<char> text(size + 1, '\0');
+    assert(clGetDeviceInfo(device, param, size, text.data(), nullptr) == CL_SUCCESS);
+    return std::string(text.data());
+}
+
+// FNV-1a hash of the program source and everything that affects its binary.
+static std::string program_key(
+    cl_device_id device,
+    const std::string &src,
+    const char *options
+) {
+    std::string parts[] = {
+        src,
+        device_info_string(device, CL_DEVICE_NAME),
+        device_info_string(device, CL_DEVICE_VERSION),
+        device_info_string(device, CL_DRIVER_VERSION),
+        options != nullptr ? options : ""
+    };
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const std::string &part : parts) {
+        for (size_t i = 0; i <= part.size(); ++i) {
+            hash ^= (uint8_t)part.c_str()[i];
+            hash *= 0x100000001b3ull;
+        }
+    }
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return ss.str();
+}
+
+static void make_dir(const std::string &dir) {
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+}
+
+bool cl::Program::load_binary(cl_context context, const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::vector<unsigned char> binary(
+        (std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>()
+    );
+    if (binary.empty()) {
+        return false;
+    }
+
+    const unsigned char *bin_data = binary.data();
+    const size_t bin_len = binary.size();
+    cl_int bin_status = CL_SUCCESS, errcode = CL_SUCCESS;
+    program = clCreateProgramWithBinary(
+        context, 1, &device,
+        &bin_len, &bin_data,
+        &bin_status, &errcode
+    );
+    if (program == nullptr) {
+        return false;
+    }
+    // Binary may be rejected by an updated driver, then rebuild from source.
+    if (
+        bin_status != CL_SUCCESS || errcode != CL_SUCCESS ||
+        clBuildProgram(program, 1, &device, nullptr, nullptr, nullptr) != CL_SUCCESS
+    ) {
+        assert(clReleaseProgram(program) == CL_SUCCESS);
+        program = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void cl::Program::store_binary(const std::string &filename) {
+    size_t bin_len = 0;
+    assert(clGetProgramInfo(
+        program, CL_PROGRAM_BINARY_SIZES,
+        sizeof(size_t), &bin_len, nullptr
+    ) == CL_SUCCESS);
+    if (bin_len == 0) {
+        return;
+    }
+    std::vector<unsigned char> binary(bin_len);
+    unsigned char *bin_data = binary.data();
+    assert(clGetProgramInfo(
+        program, CL_PROGRAM_BINARIES,
+        sizeof(unsigned char *), &bin_data, nullptr
+    ) == CL_SUCCESS);
+
+    // Write to a temporary file first, so that concurrent jobs
+    // never read a partially written binary. The random suffix
+    // keeps the jobs from writing to the same temporary file.
+    std::random_device random;
+    std::ostringstream suffix;
+    suffix << std::hex << random() << random();
+    std::string tmp_filename = filename + "." + suffix.str() + ".tmp";
+    {
+        std::ofstream file(tmp_filename, std::ios::binary);
+        if (!file) {
+            std::cerr << "Cannot write program binary to " << tmp_filename << std::endl;
+            return;
+        }
+        file.write((const char *)binary.data(), binary.size());
+    }
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp_filename.c_str());
+    }
+}
 
 cl::Program::Program(
     cl_context context,
@@ -35,7 +260,8 @@ cl::Program::Program(
     const char *path,
     const std::list<std::string> &dirs,
     const std::map<std::string, std::string> &fmem,
-    bool include_warnings
+    bool include_warnings,
+    const std::string &cache_dir
 ) {
     this->device = device;
 
@@ -49,6 +275,16 @@ cl::Program::Program(
 
     std::string src = includer->data();
     //std::fstream("gen_kernel.cl", std::ios::out) << src << std::endl;
+
+    std::string bin_filename;
+    if (!cache_dir.empty()) {
+        make_dir(cache_dir);
+        bin_filename = cache_dir + "/" + program_key(device, src, nullptr) + ".bin";
+        if (load_binary(context, bin_filename)) {
+            std::cout << "Program binary loaded from " << bin_filename << std::endl;
+            return;
+        }
+    }
     
     const char *src_data = src.c_str();
     const size_t src_len = src.size();
@@ -59,9 +295,29 @@ cl::Program::Program(
     cl_uint status = clBuildProgram(program, 1, &device, nullptr, nullptr, nullptr);
     std::cout << log() << std::endl;
     assert(status == CL_SUCCESS);
+
+    if (!bin_filename.empty()) {
+        store_binary(bin_filename);
+    }
 }
 cl::Program::~Program() {
-    assert(clReleaseProgram(program) == CL_SUCCESS);
+    if (program != nullptr) {
+        assert(clReleaseProgram(program) == CL_SUCCESS);
+    }
+}
+
+cl::Program::Program(Program &&other) :
+    program(other.program),
+    device(other.device),
+    includer(std::move(other.includer))
+{
+    other.program = nullptr;
+}
+cl::Program &cl::Program::operator=(Program &&other) {
+    std::swap(program, other.program);
+    std::swap(device, other.device);
+    std::swap(includer, other.includer);
+    return *this;
 }
 
 cl::Program::operator cl_program() const {
@@ -90,7 +346,7 @@ void cl::Buffer::init(cl_context context, size_t size) {
     _size = size;
     if (size > 0) {
         assert(context != nullptr);
-        buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, size, nullptr, nullptr);
+        buffer = clCreateBuffer(context, flags, size, nullptr, nullptr);
         assert(buffer != nullptr);
     } else {
         buffer = nullptr;
@@ -109,10 +365,30 @@ cl::Buffer::Buffer() {
 cl::Buffer::Buffer(cl_context context, size_t size) {
     init(context, size);
 }
+cl::Buffer::Buffer(cl_context context, size_t size, cl_mem_flags flags) :
+    flags(flags)
+{
+    init(context, size);
+}
 cl::Buffer::~Buffer() {
     release();
 }
 
+cl::Buffer::Buffer(Buffer &&other) :
+    buffer(other.buffer),
+    _size(other._size),
+    flags(other.flags)
+{
+    other.buffer = nullptr;
+    other._size = 0;
+}
+cl::Buffer &cl::Buffer::operator=(Buffer &&other) {
+    std::swap(buffer, other.buffer);
+    std::swap(_size, other._size);
+    std::swap(flags, other.flags);
+    return *this;
+}
+
 cl_mem &cl::Buffer::raw() {
     return buffer;
 }
@@ -129,21 +405,44 @@ size_t cl::Buffer::size() const {
 void cl::Buffer::load(cl_command_queue queue, void *data) {
     load(queue, data, _size);
 }
-void cl::Buffer::load(cl_command_queue queue, void *data, size_t size) {
+void cl::Buffer::load(cl_command_queue queue, void *data, size_t size, cl::Event *done) {
     assert(size <= _size);
     if (size <= 0) {
         return;
     }
+    if (done != nullptr) {
+        done->release();
+    }
     assert(clEnqueueReadBuffer(
         queue, buffer, CL_TRUE,
         0, size, data,
-        0, nullptr, nullptr
+        0, nullptr, done != nullptr ? &done->raw() : nullptr
     ) == CL_SUCCESS);
 }
+void cl::Buffer::load_async(
+    cl_command_queue queue, void *data, size_t size,
+    const std::vector<cl_event> &wait, cl::Event *done
+) {
+    assert(size <= _size && size > 0);
+    std::vector<cl_event> list = filter_events(wait);
+    cl_event event = nullptr;
+    assert(clEnqueueReadBuffer(
+        queue, buffer, CL_FALSE,
+        0, size, data,
+        list.size(), list.empty() ? nullptr : list.data(),
+        done != nullptr ? &event : nullptr
+    ) == CL_SUCCESS);
+    // `done` may be in the wait list, so it is replaced only now.
+    if (done != nullptr) {
+        done->release();
+        done->raw() = event;
+    }
+    assert(clFlush(queue) == CL_SUCCESS);
+}
 void cl::Buffer::store(cl_command_queue queue, const void *data) {
     store(queue, data, _size);
 }
-void cl::Buffer::store(cl_command_queue queue, const void *data, size_t size) {
+void cl::Buffer::store(cl_command_queue queue, const void *data, size_t size, cl::Event *done) {
     if (size > _size) {
         release();
 
@@ -158,20 +457,110 @@ void cl::Buffer::store(cl_command_queue queue, const void *data, size_t size) {
     if (size <= 0) {
         return;
     }
+    if (done != nullptr) {
+        done->release();
+    }
     assert(clEnqueueWriteBuffer(
         queue, buffer, CL_TRUE,
         0, size, data,
-        0, nullptr, nullptr
+        0, nullptr, done != nullptr ? &done->raw() : nullptr
     ) == CL_SUCCESS);
 }
 
+void cl::Buffer::store_range(
+    cl_command_queue queue, const void *data,
+    size_t offset, size_t size, cl::Event *done
+) {
+    assert(offset + size <= _size);
+    if (size <= 0) {
+        return;
+    }
+    if (done != nullptr) {
+        done->release();
+    }
+    assert(clEnqueueWriteBuffer(
+        queue, buffer, CL_TRUE,
+        offset, size, data,
+        0, nullptr, done != nullptr ? &done->raw() : nullptr
+    ) == CL_SUCCESS);
+}
+void *cl::Buffer::map_async(
+    cl_command_queue queue, cl_map_flags map_flags, size_t size,
+    const std::vector<cl_event> &wait, cl::Event *done
+) {
+    assert(size <= _size && size > 0);
+    std::vector<cl_event> list = filter_events(wait);
+    cl_event event = nullptr;
+    cl_int errcode;
+    void *data = clEnqueueMapBuffer(
+        queue, buffer, CL_FALSE, map_flags,
+        0, size,
+        list.size(), list.empty() ? nullptr : list.data(),
+        done != nullptr ? &event : nullptr,
+        &errcode
+    );
+    assert(errcode == CL_SUCCESS && data != nullptr);
+    // `done` may be in the wait list, so it is replaced only now.
+    if (done != nullptr) {
+        done->release();
+        done->raw() = event;
+    }
+    assert(clFlush(queue) == CL_SUCCESS);
+    return data;
+}
+void cl::Buffer::unmap(cl_command_queue queue, void *data, cl::Event *done) {
+    cl_event event = nullptr;
+    assert(clEnqueueUnmapMemObject(
+        queue, buffer, data,
+        0, nullptr, done != nullptr ? &event : nullptr
+    ) == CL_SUCCESS);
+    if (done != nullptr) {
+        done->release();
+        done->raw() = event;
+    }
+    assert(clFlush(queue) == CL_SUCCESS);
+}
+void cl::Buffer::reserve(cl_command_queue queue, size_t size) {
+    if (size <= _size) {
+        return;
+    }
+    cl_context context;
+    assert(clGetCommandQueueInfo(
+        queue, CL_QUEUE_CONTEXT,
+        sizeof(cl_context), &context, nullptr
+    ) == CL_SUCCESS);
+
+    cl_mem old_buffer = buffer;
+    size_t old_size = _size;
+    init(context, std::max(size, 2*old_size));
+    if (old_buffer != nullptr) {
+        assert(clEnqueueCopyBuffer(
+            queue, old_buffer, buffer,
+            0, 0, old_size,
+            0, nullptr, nullptr
+        ) == CL_SUCCESS);
+        // The copy keeps the old buffer alive until it is done.
+        assert(clReleaseMemObject(old_buffer) == CL_SUCCESS);
+    }
+}
+
 cl::Kernel::Kernel(cl_program program, const char *name) {
     cl_int errcode;
     kernel = clCreateKernel(program, name, &errcode);
     assert(kernel != nullptr);
 }
 cl::Kernel::~Kernel() {
-    assert(clReleaseKernel(kernel) == CL_SUCCESS);
+    if (kernel != nullptr) {
+        assert(clReleaseKernel(kernel) == CL_SUCCESS);
+    }
+}
+
+cl::Kernel::Kernel(Kernel &&other) : kernel(other.kernel) {
+    other.kernel = nullptr;
+}
+cl::Kernel &cl::Kernel::operator=(Kernel &&other) {
+    std::swap(kernel, other.kernel);
+    return *this;
 }
 
 cl::Kernel::operator cl_kernel() const {
@@ -192,3 +581,41 @@ void cl::Kernel::run(cl_command_queue queue, size_t work_size) {
     assert(clFlush(queue) == CL_SUCCESS);
     assert(clFinish(queue) == CL_SUCCESS);
 }
+void cl::Kernel::run_async(
+    cl_command_queue queue, size_t work_size,
+    const std::vector<cl_event> &wait, cl::Event *done
+) {
+    size_t global_work_size[1] = {work_size};
+    std::vector<cl_event> list = filter_events(wait);
+    cl_event event = nullptr;
+    assert(clEnqueueNDRangeKernel(
+        queue, kernel,
+        1, NULL, global_work_size, NULL,
+        list.size(), list.empty() ? nullptr : list.data(),
+        done != nullptr ? &event : nullptr
+    ) == CL_SUCCESS);
+    if (done != nullptr) {
+        done->release();
+        done->raw() = event;
+    }
+    assert(clFlush(queue) == CL_SUCCESS);
+}
+void cl::Kernel::run_async_2d(
+    cl_command_queue queue,
+    const size_t offset[2], const size_t size[2], const size_t local[2],
+    const std::vector<cl_event> &wait, cl::Event *done
+) {
+    std::vector<cl_event> list = filter_events(wait);
+    cl_event event = nullptr;
+    assert(clEnqueueNDRangeKernel(
+        queue, kernel,
+        2, offset, size, local,
+        list.size(), list.empty() ? nullptr : list.data(),
+        done != nullptr ? &event : nullptr
+    ) == CL_SUCCESS);
+    if (done != nullptr) {
+        done->release();
+        done->raw() = event;
+    }
+    assert(clFlush(queue) == CL_SUCCESS);
+}
@@ -32,13 +32,51 @@ namespace cl {
         cl_command_queue queue;
 
     public:
-        Queue(cl_context context, cl_device_id device);
+        Queue(
+            cl_context context, cl_device_id device,
+            cl_command_queue_properties properties=0
+        );
         ~Queue();
 
         Queue(const Queue &other) = delete;
         Queue &operator=(const Queue &other) = delete;
 
         operator cl_command_queue() const;
+
+        void flush();
+        void finish();
+    };
+
+    // Owns the event of an enqueued command. Empty event is considered
+    // to be already completed, so it can be passed to a wait list as is.
+    class Event {
+    private:
+        cl_event event;
+
+    public:
+        Event();
+        ~Event();
+
+        Event(const Event &other) = delete;
+        Event &operator=(const Event &other) = delete;
+        Event(Event &&other);
+        Event &operator=(Event &&other);
+
+        // Another reference to the same event.
+        Event clone() const;
+
+        cl_event &raw();
+        const cl_event &raw() const;
+        operator cl_event() const;
+        bool empty() const;
+
+        bool completed() const;
+        void wait() const;
+        void release();
+
+        // Time in seconds the command was executing on the device.
+        // The queue must be created with `CL_QUEUE_PROFILING_ENABLE`.
+        double duration() const;
     };
 
     class Program {
@@ -47,19 +85,28 @@ namespace cl {
         cl_device_id device;
         std::unique_ptr<c_includer> includer;
 
+        bool load_binary(cl_context context, const std::string &filename);
+        void store_binary(const std::string &filename);
+
     public:
+        // If `cache_dir` is not empty the built program binary is stored there
+        // and reused next time the same source is built for the same device.
         Program(
             cl_context context,
             cl_device_id device,
             const char *path,
             const std::list<std::string> &dirs={"."},
             const std::map<std::string, std::string> &fmem={},
-            bool include_warnings=false
+            bool include_warnings=false,
+            const std::string &cache_dir=""
         );
         ~Program();
 
         Program(const Program &other) = delete;
         Program &operator=(const Program &other) = delete;
+        // Programs are moved when they are rebuilt with a new source.
+        Program(Program &&other);
+        Program &operator=(Program &&other);
 
         operator cl_program() const;
 
@@ -70,6 +117,8 @@ namespace cl {
     private:
         cl_mem buffer;
         size_t _size;
+        // Flags are kept when the buffer is reallocated.
+        cl_mem_flags flags = CL_MEM_READ_WRITE;
 
         void init(cl_context context, size_t size);
         void release();
@@ -77,10 +126,16 @@ namespace cl {
     public:
         Buffer();
         Buffer(cl_context context, size_t size);
+        // E.g. `CL_MEM_ALLOC_HOST_PTR` places the buffer in host-visible memory,
+        // so mapping it doesn't copy on devices sharing memory with the host.
+        Buffer(cl_context context, size_t size, cl_mem_flags flags);
         ~Buffer();
 
         Buffer(const Buffer &other) = delete;
         Buffer &operator=(const Buffer &other) = delete;
+        // Buffers are moved when they are reallocated with a new size.
+        Buffer(Buffer &&other);
+        Buffer &operator=(Buffer &&other);
 
         cl_mem &raw();
         const cl_mem &raw() const;
@@ -88,9 +143,30 @@ namespace cl {
         size_t size() const;
 
         void load(cl_command_queue queue, void *data);
-        void load(cl_command_queue queue, void *data, size_t size);
+        void load(cl_command_queue queue, void *data, size_t size, Event *done=nullptr);
+        // Enqueues non-blocking read after the `wait` events.
+        // The `data` must stay valid until the `done` event is completed.
+        void load_async(
+            cl_command_queue queue, void *data, size_t size,
+            const std::vector<cl_event> &wait, Event *done
+        );
         void store(cl_command_queue queue, const void *data);
-        void store(cl_command_queue queue, const void *data, size_t size);
+        void store(cl_command_queue queue, const void *data, size_t size, Event *done=nullptr);
+        // Writes `size` bytes at `offset` of the buffer, the rest is kept.
+        void store_range(
+            cl_command_queue queue, const void *data,
+            size_t offset, size_t size, Event *done=nullptr
+        );
+        // Enqueues non-blocking map of the first `size` bytes after the `wait` events.
+        // The pointer may be accessed once `done` is completed and until `unmap`.
+        void *map_async(
+            cl_command_queue queue, cl_map_flags map_flags, size_t size,
+            const std::vector<cl_event> &wait, Event *done
+        );
+        void unmap(cl_command_queue queue, void *data, Event *done=nullptr);
+        // Grows the buffer to at least `size` bytes keeping its contents.
+        // The capacity is at least doubled, so appending is amortized.
+        void reserve(cl_command_queue queue, size_t size);
     };
 
     class Kernel {
@@ -103,6 +179,8 @@ namespace cl {
 
         Kernel(const Kernel &other) = delete;
         Kernel &operator=(const Kernel &other) = delete;
+        Kernel(Kernel &&other);
+        Kernel &operator=(Kernel &&other);
 
         operator cl_kernel() const;
     private:
@@ -124,11 +202,45 @@ namespace cl {
         void set_arg(size_t n, const Buffer &buf);
 
         void run(cl_command_queue queue, size_t work_size);
+        // Enqueues the kernel after the `wait` events and returns immediately.
+        void run_async(
+            cl_command_queue queue, size_t work_size,
+            const std::vector<cl_event> &wait, Event *done
+        );
+        // Enqueues the 2D range of `size` work items starting at `offset`
+        // split into work groups of `local` size. The `size` must be
+        // divisible by `local`, null `local` lets the driver choose it.
+        void run_async_2d(
+            cl_command_queue queue,
+            const size_t offset[2], const size_t size[2], const size_t local[2],
+            const std::vector<cl_event> &wait, Event *done
+        );
 
         template <typename ... Args>
         void operator()(cl_command_queue queue, size_t work_size, const Args &... args) {
             unwind_args(0, args...);
             run(queue, work_size);
         }
+
+        template <typename ... Args>
+        void enqueue(
+            cl_command_queue queue, size_t work_size,
+            const std::vector<cl_event> &wait, Event *done,
+            const Args &... args
+        ) {
+            unwind_args(0, args...);
+            run_async(queue, work_size, wait, done);
+        }
+
+        template <typename ... Args>
+        void enqueue_2d(
+            cl_command_queue queue,
+            const size_t offset[2], const size_t size[2], const size_t local[2],
+            const std::vector<cl_event> &wait, Event *done,
+            const Args &... args
+        ) {
+            unwind_args(0, args...);
+            run_async_2d(queue, offset, size, local, wait, done);
+        }
     };
 }
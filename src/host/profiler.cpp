@@ -0,0 +1,59 @@
+#include "profiler.hpp"
+
+
+Profiler::Profiler(bool enabled) :
+    enabled(enabled)
+{}
+
+bool Profiler::is_enabled() const {
+    return enabled;
+}
+
+cl::Event *Profiler::event(Kind kind) {
+    if (!enabled) {
+        return nullptr;
+    }
+    if (records.size() >= MAX_RECORDS) {
+        fold();
+    }
+    records.push_back(Record{kind, cl::Event()});
+    return &records.back().event;
+}
+
+void Profiler::record(Kind kind, const cl::Event &event) {
+    if (!enabled || event.empty()) {
+        return;
+    }
+    if (records.size() >= MAX_RECORDS) {
+        fold();
+    }
+    records.push_back(Record{kind, event.clone()});
+}
+
+void Profiler::fold() {
+    std::deque<Record> running;
+    for (Record &record : records) {
+        if (record.event.empty()) {
+            continue;
+        }
+        if (!record.event.completed()) {
+            running.push_back(std::move(record));
+            continue;
+        }
+        double time = record.event.duration();
+        if (record.kind == KERNEL) {
+            kernel_done += time;
+        } else {
+            transfer_done += time;
+        }
+    }
+    records.swap(running);
+}
+
+void Profiler::collect(double *kernel_time, double *transfer_time) {
+    fold();
+    *kernel_time += kernel_done;
+    *transfer_time += transfer_done;
+    kernel_done = 0.0;
+    transfer_done = 0.0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <deque>
+
+#include <opencl/opencl.hpp>
+
+
+// Collects device execution times of the enqueued commands.
+// When disabled it hands out no events, so the commands are not tracked.
+class Profiler {
+    public:
+    enum Kind {
+        KERNEL,
+        TRANSFER,
+    };
+
+    private:
+    struct Record {
+        Kind kind;
+        cl::Event event;
+    };
+    // Deque doesn't move its elements on `push_back`,
+    // so the pointers returned by `event()` stay valid.
+    std::deque<Record> records;
+    bool enabled;
+    // Times of the commands completed before the record list
+    // got too long, they are reported by the next `collect()`.
+    double kernel_done = 0.0, transfer_done = 0.0;
+
+    // Moves the times of completed commands to the totals above.
+    void fold();
+
+    public:
+    // Completed commands are folded once there are that many records,
+    // so they don't pile up if the stats are never taken.
+    static const size_t MAX_RECORDS = 256;
+
+    Profiler(bool enabled);
+
+    bool is_enabled() const;
+
+    // Event to pass to an enqueue function, or null if disabled.
+    cl::Event *event(Kind kind);
+    // Tracks the event which is also used for something else.
+    void record(Kind kind, const cl::Event &event);
+
+    // Adds the time of completed commands and forgets them.
+    // The commands still running are left for the next call.
+    void collect(double *kernel_time, double *transfer_time);
+};
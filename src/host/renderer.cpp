@@ -1,17 +1,65 @@
 #include "renderer.hpp"
 
+#include <bvh.hpp>
+#include <geometry/hyperbolic/tiling.hh>
+
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <vector>
 #include <cassert>
 #include <cstdint>
 #include <chrono>
-#include <random>
 #include <algorithm>
+#include <cmath>
 
 
 using duration = std::chrono::duration<double>;
 
+// Literals of the OpenCL C initializers.
+static std::string real_src(real x) {
+    std::stringstream ss;
+    ss << std::scientific << std::setprecision(9) << x << "f";
+    return ss.str();
+}
+static std::string complex_src(complex c) {
+    return "(float2)(" + real_src(c.x) + ", " + real_src(c.y) + ")";
+}
+static std::string moebius_src(Moebius m) {
+    return "{{" +
+        complex_src(m.s[0]) + ", " + complex_src(m.s[1]) + ", " +
+        complex_src(m.s[2]) + ", " + complex_src(m.s[3]) +
+    "}}";
+}
+
+static std::string gen_tiling_src() {
+    const PentagonalTiling t = pentagonal_tiling_new();
+    std::stringstream ss;
+    ss <<
+        "#define PENTAGONAL_TILING { \\" << std::endl <<
+        "    .edge = " << real_src(t.edge) << ", \\" << std::endl <<
+        "    .star = " << real_src(t.star) << ", \\" << std::endl <<
+        "    .center = " << moebius_src(t.center) << ", \\" << std::endl;
+    ss << "    .edge_fold = {";
+    for (int i = 0; i < 3; ++i) {
+        ss << (i > 0 ? ", " : "") << moebius_src(t.edge_fold[i]);
+    }
+    ss << "}, \\" << std::endl << "    .vertex_fold = {";
+    for (int i = 0; i < 2; ++i) {
+        ss << (i > 0 ? ", " : "") << moebius_src(t.vertex_fold[i]);
+    }
+    ss << "}, \\" << std::endl << "    .fold_dir = {";
+    for (int i = 0; i < 3; ++i) {
+        ss << (i > 0 ? ", " : "") << complex_src(t.fold_dir[i]);
+    }
+    ss << "}, \\" << std::endl << "    .edge_dir = {";
+    for (int i = 0; i < 5; ++i) {
+        ss << (i > 0 ? ", " : "") << complex_src(t.edge_dir[i]);
+    }
+    ss << "} \\" << std::endl << "}" << std::endl;
+    return ss.str();
+}
+
 std::string Renderer::gen_config_src(const Renderer::Config &config) {
     std::stringstream ss;
     
@@ -31,6 +79,11 @@ std::string Renderer::gen_config_src(const Renderer::Config &config) {
     if (config.blur.object_motion) {
         ss << "#define OBJECT_MOTION_BLUR" << std::endl;
     }
+    ss << "#define MOTION_SEGMENTS " << config.blur.keyframes - 1 << std::endl;
+
+    if (config.count_rays) {
+        ss << "#define COUNT_RAYS" << std::endl;
+    }
 
     if (fabs(config.gamma - 1.0) > EPS) {
         ss << 
@@ -38,9 +91,103 @@ std::string Renderer::gen_config_src(const Renderer::Config &config) {
             "#define GAMMA_VALUE " << config.gamma << "f" << std::endl;
     }
 
+    ss << std::boolalpha <<
+        "#define TRACE_CONFIG { \\" << std::endl <<
+        "    .path_max_depth = PATH_MAX_DEPTH, \\" << std::endl <<
+        "    .path_max_diffuse_depth = PATH_MAX_DIFFUSE_DEPTH, \\" << std::endl <<
+        "    .lens_blur = " << config.blur.lens << ", \\" << std::endl <<
+        "    .motion_blur = " << config.blur.motion << ", \\" << std::endl <<
+        "    .object_motion_blur = " << config.blur.object_motion << ", \\" << std::endl <<
+        "    .motion_segments = MOTION_SEGMENTS, \\" << std::endl <<
+        "    .low_discrepancy = " << config.low_discrepancy << " \\" << std::endl <<
+        "}" << std::endl;
+
+    // Tiling constants are folded into the kernel.
+    ss << gen_tiling_src();
+
+    return ss.str();
+}
+
+std::string Renderer::gen_scene_src(
+    const Renderer::Config &config,
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<bool> &insts_mask
+) {
+    std::stringstream ss;
+    ss << "#pragma once" << std::endl;
+    // Until a scene is stored the program is the generic one, the same
+    // as without specialization, so the constructor builds a usable
+    // program which binary is shared with the unspecialized renderers.
+    if (!config.specialize || insts.empty()) {
+        return ss.str();
+    }
+
+    int object_types = 0, tiling_types = 0;
+    int material_count = 1;
+    bool groups = false;
+    for (const ObjectInstance &inst : insts) {
+        object_types |= 1 << inst.type;
+        groups = groups || inst.group >= 0;
+    }
+    // Faces of the group domains are hyperbolic planes.
+    if (groups) {
+        object_types |= 1 << OBJECT_HYPLANE;
+    }
+    for (const ObjectPrototype &proto : protos) {
+        tiling_types |= 1 << proto.tiling.type;
+        material_count = std::max(material_count, proto.material_count);
+    }
+    material_count = std::min(material_count, MATERIAL_COUNT_MAX);
+
+    ss << std::hex << std::showbase <<
+        "#define SCENE_OBJECT_TYPES " << object_types << std::endl <<
+        "#define SCENE_TILING_TYPES " << tiling_types << std::endl <<
+        std::dec << std::noshowbase <<
+        "#define SCENE_MATERIAL_COUNT " << material_count << std::endl <<
+        "#define SCENE_GROUPS " << (int)groups << std::endl;
+
+    if ((int)insts.size() > config.specialize_max_objects) {
+        return ss.str();
+    }
+
+    // Only the types and the groups of the static objects are constants,
+    // their maps are read from the buffers, so moving an object doesn't
+    // change the source and the program is not rebuilt for it.
+    // Moving objects are read from the buffers as usual.
+    ss <<
+        "#define SCENE_SPECIALIZED" << std::endl <<
+        "#define SCENE_HIT_OBJECTS(scene, config, rng, time, ray, prev, path, nearest) { \\" << std::endl;
+    for (size_t i = 0; i < insts.size(); ++i) {
+        const ObjectInstance &inst = insts[i];
+        if (insts_mask[i]) {
+            ss <<
+                "    scene_hit_object(scene, config, rng, time, ray, prev, path, " <<
+                    i << ", nearest); \\" << std::endl;
+        } else {
+            ss <<
+                "    { \\" << std::endl <<
+                "        ObjectGeometry geom; \\" << std::endl <<
+                "        scene_get_geometry(scene, &geom, " << i << ", time, false); \\" << std::endl <<
+                "        geom.type = " << (int)inst.type << "; \\" << std::endl <<
+                "        geom.group = " << inst.group << "; \\" << std::endl <<
+                "        scene_hit_geometry(scene, rng, ray, prev, path, " <<
+                    i << ", &geom, nearest); \\" << std::endl <<
+                "    } \\" << std::endl;
+        }
+    }
+    ss << "}" << std::endl;
+
     return ss.str();
 }
 
+static cl_mem_flags image_flags(const Renderer::Config &config) {
+    if (config.mapped_image) {
+        return CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR;
+    }
+    return CL_MEM_READ_WRITE;
+}
+
 Renderer::Renderer(
     cl_device_id device,
     int width, int height,
@@ -48,43 +195,269 @@ Renderer::Renderer(
 ) :
     width(width),
     height(height),
+    config(config),
 
+    device(device),
     context(device),
-    queue(context, device),
+    queue(context, device, config.profiling ? CL_QUEUE_PROFILING_ENABLE : 0),
+    transfer_queue(context, device, config.profiling ? CL_QUEUE_PROFILING_ENABLE : 0),
 
+    profiler(config.profiling),
+
+    scene_src(gen_scene_src(config, {}, {}, {})),
     program(
         context, device,
         "render.cl",
         {"src/device", "src/common"},
-        {std::make_pair("gen/config.cl", gen_config_src(config))}
+        {
+            std::make_pair("gen/config.cl", gen_config_src(config)),
+            std::make_pair("gen/scene.cl", scene_src)
+        },
+        false, config.cache_dir
     ),
     kernel(program, "render"),
+    kernel_tiled(program, "render_tiled"),
+    kernel_upscale(program, "upscale_image"),
+    kernel_write(program, "write_image"),
+    kernel_animate(program, "animate_tracks"),
 
-    image(context, width*height*4),
+    images{
+        {context, (size_t)width*height*4, image_flags(config)},
+        {context, (size_t)width*height*4, image_flags(config)}
+    },
+    host_image(width*height*4, 0),
     screen(context, width*height*3*sizeof(cl_float)),
 
-    seeds(context, width*height*sizeof(cl_uint))
+    ray_counter(context, sizeof(cl_uint)),
+    stats_start(std::chrono::steady_clock::now()),
+    view_motion(context, sizeof(ViewMotionPk)*(config.blur.keyframes - 1))
 {
-    std::mt19937 rng(0xdeadbeef);
-    std::vector<uint32_t> host_seeds(width*height);
-    for (uint32_t &seed : host_seeds) {
-        seed = rng();
+    for (cl::Buffer &image : images) {
+        image.store(queue, host_image.data(), host_image.size());
     }
-    seeds.store(queue, host_seeds.data());
+    const cl_uint zero = 0;
+    ray_counter.store(queue, &zero, sizeof(cl_uint));
 
+    assert(config.blur.keyframes >= 2);
+    assert(!(config.wavefront && config.adaptive.enabled));
+    assert(!(config.tiled.enabled && (config.wavefront || config.adaptive.enabled)));
+    assert(!(config.temporal.enabled && (config.wavefront || config.adaptive.enabled)));
+    assert(config.tiled.tile_width > 0 && config.tiled.tile_height > 0);
+    chunk_rows = std::max(config.tiled.chunk_rows, 1);
+    launch_samples = std::max(config.batch.samples_per_launch, 1);
+    if (config.wavefront) {
+        wavefront = std::make_unique<Wavefront>(context, program, width*height);
+    }
+    if (config.adaptive.enabled) {
+        adaptive = std::make_unique<AdaptiveSampler>(context, queue, program, width*height);
+    }
+    if (config.temporal.enabled) {
+        temporal = std::make_unique<TemporalReprojection>(context, program, width*height);
+    }
+
+    update_render_size();
     set_view(view_init());
 }
+Renderer::~Renderer() {
+    queue.finish();
+    for (int i = 0; i < 2; ++i) {
+        if (image_maps[i] != nullptr) {
+            images[i].unmap(transfer_queue, image_maps[i]);
+        }
+    }
+    transfer_queue.finish();
+}
+
+void Renderer::resize(int w, int h) {
+    assert(w > 0 && h > 0);
+    // Nothing may use the old buffers.
+    queue.finish();
+    for (int i = 0; i < 2; ++i) {
+        if (image_maps[i] != nullptr) {
+            images[i].unmap(transfer_queue, image_maps[i]);
+            image_maps[i] = nullptr;
+        }
+    }
+    transfer_queue.finish();
+    for (int i = 0; i < 2; ++i) {
+        image_read[i] = cl::Event();
+    }
+    last_render = cl::Event();
+    back = 0;
+    back_dirty = false;
+
+    width = w;
+    height = h;
+    host_image.assign(width*height*4, 0);
+    for (cl::Buffer &image : images) {
+        image = cl::Buffer(context, host_image.size(), image_flags(config));
+        image.store(queue, host_image.data(), host_image.size());
+    }
+    screen = cl::Buffer(context, width*height*3*sizeof(cl_float));
+    if (wavefront) {
+        wavefront = std::make_unique<Wavefront>(context, program, width*height);
+    }
+    if (adaptive) {
+        adaptive = std::make_unique<AdaptiveSampler>(context, queue, program, width*height);
+    }
+    if (temporal) {
+        temporal = std::make_unique<TemporalReprojection>(context, program, width*height);
+    }
+
+    update_render_size();
+    size_changed = true;
+}
+
+void Renderer::set_render_scale(double scale) {
+    assert(scale > 0.0 && scale <= 1.0);
+    render_scale = scale;
+    update_render_size();
+}
+
+void Renderer::update_render_size() {
+    int w = std::max(1, (int)std::ceil(render_scale*width));
+    int h = std::max(1, (int)std::ceil(render_scale*height));
+    if (w != render_width || h != render_height) {
+        render_width = w;
+        render_height = h;
+        // Temporal accumulation reprojects the image to the new size.
+        size_changed = !temporal;
+    }
+}
+
+void Renderer::build_program() {
+    program = cl::Program(
+        context, device,
+        "render.cl",
+        {"src/device", "src/common"},
+        {
+            std::make_pair("gen/config.cl", gen_config_src(config)),
+            std::make_pair("gen/scene.cl", scene_src)
+        },
+        false, config.cache_dir
+    );
+    // Kernels enqueued before keep the old program alive until they complete.
+    kernel = cl::Kernel(program, "render");
+    kernel_tiled = cl::Kernel(program, "render_tiled");
+    kernel_upscale = cl::Kernel(program, "upscale_image");
+    kernel_write = cl::Kernel(program, "write_image");
+    kernel_animate = cl::Kernel(program, "animate_tracks");
+    if (wavefront) {
+        wavefront->load_kernels(program);
+    }
+    if (adaptive) {
+        adaptive->load_kernels(program);
+    }
+    if (temporal) {
+        temporal->load_kernels(program);
+    }
+}
 
-void Renderer::store_objs_to_buf(
-    cl::Queue &queue, cl::Buffer &buf,
-    const std::vector<Object> &objs
+void Renderer::specialize_scene() {
+    if (!config.specialize) {
+        return;
+    }
+    std::vector<ObjectPrototype> protos = prototypes;
+    protos.insert(protos.end(), track_prototypes.begin(), track_prototypes.end());
+    std::string src = gen_scene_src(config, protos, instances, instances_mask);
+    if (src != scene_src) {
+        scene_src = src;
+        build_program();
+    }
+}
+
+void Renderer::store_prototypes_to_buf(
+    cl::Buffer &buf,
+    const std::vector<ObjectPrototype> &protos,
+    size_t first
 ) {
-    std::vector<ObjectPk> pack(objs.size());
+    shading_staging.resize(protos.size());
+    for (size_t i = 0; i < protos.size(); ++i) {
+        pack_object_prototype(&shading_staging[i], &protos[i]);
+    }
+    buf.reserve(queue, sizeof(ObjectShadingPk)*(first + protos.size()));
+    buf.store_range(
+        queue, shading_staging.data(),
+        sizeof(ObjectShadingPk)*first, sizeof(ObjectShadingPk)*protos.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+}
 
-    for (size_t i = 0; i < objs.size(); ++i) {
-        pack_object(&pack[i], &objs[i]);
+void Renderer::store_instances_to_buf(
+    cl::Buffer &buf,
+    const std::vector<ObjectInstance> &insts,
+    size_t first
+) {
+    geometry_staging.resize(insts.size());
+    for (size_t i = 0; i < insts.size(); ++i) {
+        pack_object_instance(&geometry_staging[i], &insts[i]);
     }
-    buf.store(queue, pack.data(), sizeof(ObjectPk)*objs.size());
+    buf.reserve(queue, sizeof(ObjectGeometryPk)*(first + insts.size()));
+    buf.store_range(
+        queue, geometry_staging.data(),
+        sizeof(ObjectGeometryPk)*first, sizeof(ObjectGeometryPk)*insts.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+}
+
+void Renderer::store_motion_to_buf(
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    size_t first
+) {
+    const int segments = config.blur.keyframes - 1;
+    motion_staging.resize(insts.size()*segments);
+    std::vector<Moebius> maps;
+    for (size_t i = 0; i < insts.size(); ++i) {
+        maps.clear();
+        for (const std::vector<ObjectInstance> &frame : insts_keyframes) {
+            assert(frame.size() == insts.size());
+            maps.push_back(frame[i].map);
+        }
+        maps.push_back(insts[i].map);
+        maps = resample_keyframes(maps, segments + 1, mo_interpolate);
+        for (int k = 0; k < segments; ++k) {
+            motion_staging[i*segments + k] = mo_path_pack(mo_path_new(maps[k], maps[k + 1]));
+        }
+    }
+    const size_t record = sizeof(MoebiusPathPk)*segments;
+    objects_motion.reserve(queue, record*(first + insts.size()));
+    objects_motion.store_range(
+        queue, motion_staging.data(),
+        record*first, record*insts.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+}
+
+void Renderer::store_mask_to_buf(
+    const std::vector<bool> &insts_mask,
+    size_t first
+) {
+    mask_staging.resize(insts_mask.size());
+    std::transform(
+        insts_mask.begin(), insts_mask.end(),
+        mask_staging.begin(), [](bool x) { return (uchar_pk)x; }
+    );
+    objects_mask.reserve(queue, first + insts_mask.size());
+    objects_mask.store_range(
+        queue, mask_staging.data(),
+        first, mask_staging.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+}
+
+void Renderer::store_bvh() {
+    Bvh bvh(instances, instances_mask);
+    bvh_nodes.store(
+        queue, bvh.nodes.data(), sizeof(BvhNodePk)*bvh.nodes.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+    bvh_indices.store(
+        queue, bvh.indices.data(), sizeof(int_pk)*bvh.indices.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+    bvh_node_count = bvh.nodes.size();
+    bvh_unbounded_count = bvh.unbounded_count;
 }
 
 void Renderer::store_objects(const std::vector<Object> &objs) {
@@ -100,63 +473,731 @@ void Renderer::store_objects(
     const std::vector<Object> &objs_prev,
     const std::vector<bool> &objs_mask
 ) {
-    store_objs_to_buf(queue, objects, objs);
+    store_objects(objs, single_keyframe(objs_prev), objs_mask);
+}
+
+void Renderer::store_objects(
+    const std::vector<Object> &objs,
+    const std::vector<std::vector<Object>> &objs_keyframes,
+    const std::vector<bool> &objs_mask
+) {
+    std::vector<ObjectPrototype> protos, protos_prev;
+    std::vector<ObjectInstance> insts;
+    std::vector<std::vector<ObjectInstance>> insts_keyframes;
+    split_objects(objs, &protos, &insts);
+    split_keyframes(objs_keyframes, &protos_prev, &insts_keyframes);
+    store_scene(protos, protos_prev, insts, insts_keyframes, objs_mask);
+}
+
+void Renderer::store_objects(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectInstance> &insts
+) {
+    store_objects(
+        protos, insts,
+        std::vector<ObjectInstance>(),
+        std::vector<bool>(insts.size(), false)
+    );
+}
+
+void Renderer::store_objects(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<ObjectInstance> &insts_prev,
+    const std::vector<bool> &insts_mask
+) {
+    store_objects(protos, insts, single_keyframe(insts_prev), insts_mask);
+}
+
+void Renderer::store_objects(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    store_scene(protos, std::vector<ObjectPrototype>(), insts, insts_keyframes, insts_mask);
+}
+
+void Renderer::update_objects(
+    int first,
+    const std::vector<Object> &objs,
+    const std::vector<Object> &objs_prev,
+    const std::vector<bool> &objs_mask
+) {
+    update_objects(first, objs, single_keyframe(objs_prev), objs_mask);
+}
+
+void Renderer::update_objects(
+    int first,
+    const std::vector<Object> &objs,
+    const std::vector<std::vector<Object>> &objs_keyframes,
+    const std::vector<bool> &objs_mask
+) {
+    std::vector<ObjectPrototype> protos, protos_prev;
+    std::vector<ObjectInstance> insts;
+    std::vector<std::vector<ObjectInstance>> insts_keyframes;
+    split_objects(objs, &protos, &insts);
+    split_keyframes(objs_keyframes, &protos_prev, &insts_keyframes);
+    // Every object is its own prototype with the same index.
+    for (size_t i = 0; i < insts.size(); ++i) {
+        insts[i].prototype = first + (int)i;
+    }
+    update_scene(first, protos, protos_prev, insts, insts_keyframes, objs_mask);
+}
+
+void Renderer::update_objects(
+    int first,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<ObjectInstance> &insts_prev,
+    const std::vector<bool> &insts_mask
+) {
+    update_objects(first, insts, single_keyframe(insts_prev), insts_mask);
+}
 
-    if (objs_prev.size() > 0) {
-        assert(objs.size() == objs_prev.size());
-        store_objs_to_buf(queue, objects_prev, objs_prev);
+void Renderer::update_objects(
+    int first,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    update_scene(
+        first,
+        std::vector<ObjectPrototype>(), std::vector<ObjectPrototype>(),
+        insts, insts_keyframes, insts_mask
+    );
+}
+
+void Renderer::store_scene(
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectPrototype> &protos_prev,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    for (const ObjectInstance &inst : insts) {
+        assert(inst.prototype >= 0 && inst.prototype < (int)protos.size());
+        assert(inst.group < group_count);
     }
 
-    assert(objs.size() == objs_mask.size());
-    std::vector<uchar_pk> mask_pk(objs_mask.size());
-    std::transform(
-        objs_mask.begin(), objs_mask.end(),
-        mask_pk.begin(), [](bool x) { return (uchar_pk)x; }
+    store_prototypes_to_buf(objects_shading, protos, 0);
+    // Moving instances interpolate the shading as well, so the previous
+    // table must exist even if it is the same. It is stored in any case
+    // because the instances may start moving on update.
+    if (protos_prev.size() > 0) {
+        assert(protos.size() == protos_prev.size());
+        store_prototypes_to_buf(objects_shading_prev, protos_prev, 0);
+    } else {
+        store_prototypes_to_buf(objects_shading_prev, protos, 0);
+    }
+    prototype_count = protos.size();
+
+    store_instances_to_buf(objects_geometry, insts, 0);
+    store_motion_to_buf(insts, insts_keyframes, 0);
+
+    assert(insts.size() == insts_mask.size());
+    store_mask_to_buf(insts_mask, 0);
+
+    object_count = insts.size();
+    instances = insts;
+    instances_mask = insts_mask;
+    if (config.specialize) {
+        prototypes = protos;
+    }
+    store_bvh();
+    specialize_scene();
+}
+
+void Renderer::update_scene(
+    int first,
+    const std::vector<ObjectPrototype> &protos,
+    const std::vector<ObjectPrototype> &protos_prev,
+    const std::vector<ObjectInstance> &insts,
+    const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+    const std::vector<bool> &insts_mask
+) {
+    assert(first >= 0 && first <= object_count);
+    assert(insts.size() == insts_mask.size());
+
+    if (protos.size() > 0) {
+        assert(first <= prototype_count);
+        store_prototypes_to_buf(objects_shading, protos, first);
+        if (protos_prev.size() > 0) {
+            assert(protos.size() == protos_prev.size());
+            store_prototypes_to_buf(objects_shading_prev, protos_prev, first);
+        } else {
+            store_prototypes_to_buf(objects_shading_prev, protos, first);
+        }
+        prototype_count = std::max(prototype_count, first + (int)protos.size());
+        if (config.specialize) {
+            prototypes.resize(prototype_count);
+            std::copy(protos.begin(), protos.end(), prototypes.begin() + first);
+        }
+    }
+
+    // Moving objects are not in the hierarchy, so it is rebuilt
+    // only if any of the replaced objects is bounded or the count changes.
+    bool rebuild = first + insts.size() > instances.size();
+    for (size_t i = 0; i < insts.size(); ++i) {
+        assert(insts[i].prototype >= 0 && insts[i].prototype < prototype_count);
+        assert(insts[i].group < group_count);
+        size_t j = first + i;
+        if (j < instances.size()) {
+            rebuild = rebuild || Bvh::is_bounded(instances[j], instances_mask[j]);
+            instances[j] = insts[i];
+            instances_mask[j] = insts_mask[i];
+        } else {
+            instances.push_back(insts[i]);
+            instances_mask.push_back(insts_mask[i]);
+        }
+        rebuild = rebuild || Bvh::is_bounded(insts[i], insts_mask[i]);
+    }
+
+    store_instances_to_buf(objects_geometry, insts, first);
+    // The motion is read only for the moving instances,
+    // but the whole range is kept valid in case they start moving later.
+    store_motion_to_buf(insts, insts_keyframes, first);
+    store_mask_to_buf(insts_mask, first);
+
+    object_count = instances.size();
+    if (rebuild) {
+        store_bvh();
+    }
+    specialize_scene();
+}
+
+void Renderer::store_groups(const std::vector<Group> &grps) {
+    std::vector<GroupPk> groups_pack(grps.size());
+    for (size_t i = 0; i < grps.size(); ++i) {
+        // Every face must have the paired one, see `group_prepare`.
+        for (int k = 0; k < grps[i].count; ++k) {
+            assert(grps[i].inverse[k] >= 0 && grps[i].inverse[k] < grps[i].count);
+        }
+        pack_group(&groups_pack[i], &grps[i]);
+    }
+    groups.store(
+        queue, groups_pack.data(), sizeof(GroupPk)*grps.size(),
+        profiler.event(Profiler::TRANSFER)
     );
-    objects_mask.store(queue, mask_pk.data(), mask_pk.size());
+    group_count = grps.size();
+}
 
-    object_count = objs.size();
+void Renderer::store_tracks(const std::vector<ObjectTrack> &trks) {
+    std::vector<TrackPk> tracks_pack(trks.size());
+    std::vector<TrackKeyPk> keys_pack;
+    std::vector<ObjectPrototype> protos;
+    std::vector<ObjectInstance> insts;
+    std::vector<bool> insts_mask;
+    for (size_t i = 0; i < trks.size(); ++i) {
+        const ObjectTrack &trk = trks[i];
+        assert(trk.keys.size() > 0 && trk.keys.size() == trk.times.size());
+        tracks_pack[i].first = keys_pack.size();
+        tracks_pack[i].count = trk.keys.size();
+        for (size_t k = 0; k < trk.keys.size(); ++k) {
+            const Object &obj = trk.keys[k];
+            const Moebius next = k + 1 < trk.keys.size() ? trk.keys[k + 1].map : obj.map;
+            TrackKeyPk key;
+            key.time = (real_pk)trk.times[k];
+            ObjectInstance inst = object_instance(&obj, (int)i);
+            pack_object_instance(&key.geometry, &inst);
+            ObjectPrototype proto = object_prototype(&obj);
+            pack_object_prototype(&key.shading, &proto);
+            key.path = mo_path_pack(mo_path_new(obj.map, next));
+            keys_pack.push_back(key);
+        }
+        protos.push_back(object_prototype(&trk.keys.front()));
+        insts.push_back(object_instance(&trk.keys.front(), (int)i));
+        insts_mask.push_back(trk.keys.size() > 1);
+    }
+    tracks.store(
+        queue, tracks_pack.data(), sizeof(TrackPk)*tracks_pack.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+    track_keys.store(
+        queue, keys_pack.data(), sizeof(TrackKeyPk)*keys_pack.size(),
+        profiler.event(Profiler::TRANSFER)
+    );
+    track_count = trks.size();
+
+    track_prototypes.clear();
+    if (config.specialize) {
+        for (const ObjectTrack &trk : trks) {
+            for (const Object &obj : trk.keys) {
+                track_prototypes.push_back(object_prototype(&obj));
+            }
+        }
+    }
+    store_scene(protos, {}, insts, {}, insts_mask);
+}
+
+void Renderer::set_time(double time, double shutter) {
+    if (track_count <= 0) {
+        return;
+    }
+    kernel_animate.enqueue(
+        queue, track_count, {}, profiler.event(Profiler::KERNEL),
+        tracks, track_keys, track_count,
+        (cl_float)time, (cl_float)shutter,
+
+        objects_geometry, objects_motion,
+        objects_shading, objects_shading_prev
+    );
+}
+
+void Renderer::swap_image() {
+    if (!back_dirty) {
+        return;
+    }
+    if (render_width != width || render_height != height) {
+        // The image written by the rendering is of the smaller size,
+        // so it is replaced with the upscaled one.
+        cl::Event event;
+        kernel_upscale.enqueue(
+            queue, width*height,
+            {image_read[back]}, &event,
+            screen, images[back],
+            render_width, render_height,
+            width, height
+        );
+        profiler.record(Profiler::KERNEL, event);
+        last_render = std::move(event);
+    } else if (adaptive || config.tiled.enabled) {
+        // Adaptive sampling doesn't touch the converged pixels of the image.
+        // In tiled mode the bands rendered before the previous swap went to
+        // the other image, and the rest of the pass in progress is not
+        // rendered yet, so those rows hold an older frame. The whole image
+        // is written at once from the accumulated colors. A reprojecting
+        // pass accumulates to the back buffers, so until it completes
+        // the image of the previous pass is shown.
+        cl::Event event;
+        kernel_write.enqueue(
+            queue, width*height,
+            {image_read[back]}, &event,
+            screen, images[back]
+        );
+        profiler.record(Profiler::KERNEL, event);
+        last_render = std::move(event);
+    }
+    if (config.mapped_image) {
+        // The front image becomes the back one, so it is unmapped
+        // and the next rendering waits for that.
+        const int front = 1 - back;
+        if (image_maps[front] != nullptr) {
+            images[front].unmap(transfer_queue, image_maps[front], &image_read[front]);
+            image_maps[front] = nullptr;
+        }
+        image_maps[back] = (uint8_t *)images[back].map_async(
+            transfer_queue, CL_MAP_READ, images[back].size(),
+            {last_render}, &image_read[back]
+        );
+    } else {
+        images[back].load_async(
+            transfer_queue, host_image.data(), host_image.size(),
+            {last_render}, &image_read[back]
+        );
+    }
+    profiler.record(Profiler::TRANSFER, image_read[back]);
+    back = 1 - back;
+    back_dirty = false;
 }
 
 void Renderer::load_image(uint8_t *data) {
-    image.load(queue, data);
+    const uint8_t *src = image_data();
+    std::copy(src, src + host_image.size(), data);
+}
+
+const uint8_t *Renderer::image_data() {
+    const int front = 1 - back;
+    image_read[front].wait();
+    if (image_maps[front] != nullptr) {
+        return image_maps[front];
+    }
+    return host_image.data();
+}
+
+void Renderer::load_screen(float *data) {
+    screen.load(queue, data, screen.size(), profiler.event(Profiler::TRANSFER));
+}
+
+int Renderer::active_pixel_count() const {
+    if (adaptive) {
+        return adaptive->active_pixel_count;
+    }
+    return render_width*render_height;
 }
 
 void Renderer::set_view(const View &v) {
     set_view(v, v);
 }
 void Renderer::set_view(const View &v, const View &vp) {
+    set_view(v, std::vector<View>{vp});
+}
+void Renderer::set_view(const View &v, const std::vector<View> &keyframes) {
     view = view_pack(v);
-    view_prev = view_pack(vp);
+    std::vector<View> views(keyframes);
+    views.push_back(v);
+    views = resample_keyframes(views, config.blur.keyframes, view_interpolate);
+    // The eigendecomposition of the relative maps is done here
+    // in double precision once per frame instead of for every sample.
+    view_motion_staging.resize(views.size() - 1);
+    for (size_t k = 0; k + 1 < views.size(); ++k) {
+        view_motion_staging[k] = view_motion_pack(view_motion_new(views[k], views[k + 1]));
+    }
+    view_motion.store(
+        queue, view_motion_staging.data(),
+        sizeof(ViewMotionPk)*view_motion_staging.size()
+    );
 }
 
-void Renderer::render(bool fresh) {
-    if (fresh) {
+int Renderer::render(bool fresh) {
+    return render_pass(fresh, launch_samples);
+}
+
+int Renderer::render_pass(bool fresh, int max_samples) {
+    if (config.tiled.enabled) {
+        while (!render_chunk(fresh, max_samples)) {
+            fresh = false;
+        }
+        return pass_samples;
+    }
+    if (fresh || size_changed) {
+        fresh = true;
+        size_changed = false;
         monte_carlo_counter = 0;
+        frame_counter += 1;
     }
 
-    kernel(
-        queue, width*height,
-        screen, image,
-        width, height,
-        monte_carlo_counter,
-        seeds,
+    // Other modes trace a sample per launch.
+    const bool batched = !wavefront && !adaptive && !temporal;
+    const int samples = batched ? std::min(launch_samples, max_samples) : 1;
+
+    cl::Event event;
+    if (wavefront) {
+        render_wavefront(&event);
+    } else if (adaptive) {
+        render_adaptive(fresh, &event);
+    } else if (temporal) {
+        temporal->begin_pass(view, render_width, render_height, fresh);
+        const size_t offset[2] = {0, 0};
+        const size_t size[2] = {(size_t)render_width, (size_t)render_height};
+        render_temporal(offset, size, nullptr, &event);
+        temporal->end_pass(screen);
+    } else {
+        // The back image may still be read from the previous swap.
+        kernel.enqueue(
+            queue, render_width*render_height,
+            {image_read[back]}, &event,
+            screen, images[back],
+            render_width, render_height,
+            frame_counter, monte_carlo_counter, (cl_int)samples,
+
+            view, view_motion,
+
+            objects_geometry, objects_motion,
+            objects_shading, objects_shading_prev,
+            objects_mask, object_count,
+
+            bvh_nodes, bvh_indices,
+            bvh_node_count, bvh_unbounded_count,
+
+            groups,
+
+            ray_counter
+        );
+    }
+    profiler.record(Profiler::KERNEL, event);
+    last_render.wait();
+    // The previous launch is completed now, its time per sample
+    // gives the number of samples of the next launches.
+    if (
+        batched && config.batch.auto_tune && config.profiling &&
+        last_launch_samples > 0 && !last_render.empty()
+    ) {
+        double time = last_render.duration();
+        if (time > 0.0) {
+            int fit = (int)(config.batch.launch_time/time*last_launch_samples);
+            launch_samples = std::max(1, std::min(fit, config.batch.max_samples_per_launch));
+        }
+    }
+    last_render = std::move(event);
+    last_launch_samples = samples;
+    back_dirty = true;
+
+    stats_passes += 1;
+    stats_samples += (long long)active_pixel_count()*samples;
+
+    monte_carlo_counter += samples;
+    return samples;
+}
+
+bool Renderer::render_chunk(bool fresh) {
+    return render_chunk(fresh, launch_samples);
+}
+
+bool Renderer::render_chunk(bool fresh, int max_samples) {
+    assert(config.tiled.enabled);
+    if (fresh || size_changed) {
+        size_changed = false;
+        monte_carlo_counter = 0;
+        frame_counter += 1;
+        chunk_start = 0;
+    }
+    // All the bands of the pass trace the same samples.
+    if (chunk_start == 0) {
+        pass_samples = temporal ? 1 : std::min(launch_samples, max_samples);
+    }
+    // A view change in the middle of the pass doesn't restart it,
+    // the remaining bands are traced with the view it was started with,
+    // so that the pass always completes and becomes the history.
+    if (temporal && chunk_start == 0) {
+        temporal->begin_pass(view, render_width, render_height, fresh);
+    }
+
+    const int tw = config.tiled.tile_width, th = config.tiled.tile_height;
+    const int rows = (render_height + th - 1)/th;
+    const int count = std::min(chunk_rows, rows - chunk_start);
+    const size_t offset[2] = {0, (size_t)(chunk_start*th)};
+    const size_t size[2] = {(size_t)((render_width + tw - 1)/tw*tw), (size_t)(count*th)};
+    const size_t local[2] = {(size_t)tw, (size_t)th};
+
+    cl::Event event;
+    if (temporal) {
+        render_temporal(offset, size, local, &event);
+    } else {
+        kernel_tiled.enqueue_2d(
+            queue, offset, size, local,
+            {image_read[back]}, &event,
+            screen, images[back],
+            render_width, render_height,
+            frame_counter, monte_carlo_counter, (cl_int)pass_samples,
+
+            view, view_motion,
+
+            objects_geometry, objects_motion,
+            objects_shading, objects_shading_prev,
+            objects_mask, object_count,
 
-        view, view_prev,
+            bvh_nodes, bvh_indices,
+            bvh_node_count, bvh_unbounded_count,
 
-        objects, objects_prev,
-        objects_mask, object_count
+            groups,
+
+            ray_counter
+        );
+    }
+    profiler.record(Profiler::KERNEL, event);
+    last_render.wait();
+    // The previous band is completed now, its time per row
+    // gives the height of the next bands.
+    if (config.profiling && last_chunk_rows > 0 && !last_render.empty()) {
+        double time = last_render.duration();
+        if (time > 0.0) {
+            int fit = (int)(config.tiled.chunk_time/time*last_chunk_rows);
+            chunk_rows = std::max(1, std::min(fit, rows));
+        }
+    }
+    last_render = std::move(event);
+    last_chunk_rows = count;
+    back_dirty = true;
+
+    stats_samples += (long long)pass_samples*render_width*(std::min((chunk_start + count)*th, render_height) - chunk_start*th);
+    chunk_start += count;
+    if (chunk_start < rows) {
+        return false;
+    }
+    chunk_start = 0;
+    if (temporal) {
+        temporal->end_pass(screen);
+    }
+    stats_passes += 1;
+    monte_carlo_counter += pass_samples;
+    return true;
+}
+
+void Renderer::render_temporal(
+    const size_t offset[2], const size_t size[2], const size_t local[2],
+    cl::Event *done
+) {
+    TemporalReprojection &tr = *temporal;
+    // The reprojecting pass writes to the back buffers.
+    cl::Buffer &out_screen = tr.reprojecting ? tr.screen_back : screen;
+    cl::Buffer &out_hits = tr.reprojecting ? tr.hits_back : tr.hits;
+    cl::Buffer &out_counts = tr.reprojecting ? tr.sample_counts_back : tr.sample_counts;
+    cl::Buffer &in_screen = tr.reprojecting ? screen : tr.screen_back;
+    cl::Buffer &in_hits = tr.reprojecting ? tr.hits : tr.hits_back;
+    cl::Buffer &in_counts = tr.reprojecting ? tr.sample_counts : tr.sample_counts_back;
+
+    tr.render.enqueue_2d(
+        queue, offset, size, local,
+        {image_read[back]}, done,
+        out_screen, images[back], out_hits, out_counts,
+        render_width, render_height,
+        frame_counter, monte_carlo_counter,
+
+        in_screen, in_hits, in_counts,
+        tr.history_width, tr.history_height,
+        tr.history_view,
+        (cl_int)tr.fresh, (cl_int)tr.reprojecting,
+        (cl_int)config.temporal.max_history,
+        (cl_float)config.temporal.hit_tolerance,
+
+        tr.pass_view, view_motion,
+
+        objects_geometry, objects_motion,
+        objects_shading, objects_shading_prev,
+        objects_mask, object_count,
+
+        bvh_nodes, bvh_indices,
+        bvh_node_count, bvh_unbounded_count,
+
+        groups,
+
+        ray_counter
+    );
+}
+
+void Renderer::render_wavefront(cl::Event *done) {
+    Wavefront &wf = *wavefront;
+    const size_t path_count = render_width*render_height;
+
+    wf.generate.enqueue(
+        queue, path_count, {}, profiler.event(Profiler::KERNEL),
+        render_width, render_height,
+        frame_counter, monte_carlo_counter,
+
+        view, view_motion,
+
+        wf.ray_start, wf.ray_direction,
+        wf.color, wf.light,
+        wf.flags, wf.prev, wf.diffuse,
+        wf.time,
+
+        wf.paths_a, wf.count_a
+    );
+
+    // The work size is kept the same, threads beyond the number of
+    // active paths exit immediately, so the host never waits for it.
+    cl::Buffer *paths_in = &wf.paths_a, *paths_out = &wf.paths_b;
+    cl::Buffer *count_in = &wf.count_a, *count_out = &wf.count_b;
+    for (int k = 0; k < config.path_max_depth; ++k) {
+        wf.intersect.enqueue(
+            queue, path_count, {}, profiler.event(Profiler::KERNEL),
+            frame_counter, monte_carlo_counter, k,
+
+            objects_geometry, objects_motion,
+            objects_shading, objects_shading_prev,
+            objects_mask, object_count,
+
+            bvh_nodes, bvh_indices,
+            bvh_node_count, bvh_unbounded_count,
+
+            groups,
+
+            wf.ray_start, wf.ray_direction,
+            wf.color, wf.light,
+            wf.flags, wf.prev, wf.diffuse,
+            wf.time,
+
+            wf.hit_index, wf.hit_pos, wf.hit_dir, wf.hit_flags, wf.hit_element,
+
+            *paths_in, *count_in, *count_out,
+
+            ray_counter
+        );
+        wf.shade.enqueue(
+            queue, path_count, {}, profiler.event(Profiler::KERNEL),
+            frame_counter, monte_carlo_counter, k,
+
+            objects_geometry, objects_motion,
+            objects_shading, objects_shading_prev,
+            objects_mask, object_count,
+
+            bvh_nodes, bvh_indices,
+            bvh_node_count, bvh_unbounded_count,
+
+            groups,
+
+            wf.ray_start, wf.ray_direction,
+            wf.color, wf.light,
+            wf.flags, wf.prev, wf.diffuse,
+            wf.time,
+
+            wf.hit_index, wf.hit_pos, wf.hit_dir, wf.hit_flags, wf.hit_element,
+
+            *paths_in, *count_in, *paths_out, *count_out
+        );
+        std::swap(paths_in, paths_out);
+        std::swap(count_in, count_out);
+    }
+
+    wf.accumulate.enqueue(
+        queue, path_count, {image_read[back]}, done,
+        screen, images[back],
+        monte_carlo_counter,
+
+        wf.color
     );
+}
+
+void Renderer::render_adaptive(bool fresh, cl::Event *done) {
+    AdaptiveSampler &ad = *adaptive;
+
+    if (fresh || ad.passes >= config.adaptive.interval) {
+        const cl_int zero = 0;
+        ad.active_count.store(
+            queue, &zero, sizeof(cl_int),
+            profiler.event(Profiler::TRANSFER)
+        );
+        ad.update_active.enqueue(
+            queue, render_width*render_height, {}, profiler.event(Profiler::KERNEL),
+            screen, ad.screen_sq, ad.sample_counts,
+            ad.active_pixels, ad.active_count,
+            (cl_int)fresh,
+            (cl_int)config.adaptive.min_samples,
+            (cl_float)config.adaptive.threshold
+        );
+        // Blocking read of a single value, the work size depends on it.
+        cl_int count = 0;
+        ad.active_count.load(
+            queue, &count, sizeof(cl_int),
+            profiler.event(Profiler::TRANSFER)
+        );
+        ad.active_pixel_count = count;
+        ad.passes = 0;
+    }
+    ad.passes += 1;
+
+    if (ad.active_pixel_count <= 0) {
+        return;
+    }
+    ad.render.enqueue(
+        queue, ad.active_pixel_count, {}, done,
+        screen, ad.screen_sq, ad.sample_counts,
+        render_width, render_height,
+        frame_counter,
+
+        view, view_motion,
+
+        objects_geometry, objects_motion,
+        objects_shading, objects_shading_prev,
+        objects_mask, object_count,
+
+        bvh_nodes, bvh_indices,
+        bvh_node_count, bvh_unbounded_count,
 
-    monte_carlo_counter += 1;
+        groups,
+
+        ad.active_pixels,
+        ray_counter
+    );
 }
 
 int Renderer::render_n(int n, bool fresh) {
-    for (int i = 0; i < n; ++i) {
-        render(fresh);
+    int samples = 0;
+    while (samples < n) {
+        samples += render_pass(fresh, n - samples);
         fresh = false;
-    };
-    return n;
+    }
+    return samples;
 }
 
 int Renderer::render_for(double sec, bool fresh) {
@@ -164,11 +1205,62 @@ int Renderer::render_for(double sec, bool fresh) {
     
     int sample_counter = 0;
     auto start = std::chrono::system_clock::now();
+    if (config.tiled.enabled) {
+        do {
+            if (render_chunk(fresh)) {
+                sample_counter += pass_samples;
+            }
+            fresh = false;
+        } while(
+            monte_carlo_counter == 0 ||
+            std::chrono::system_clock::now() - start < render_time
+        );
+        return sample_counter;
+    }
     do {
-        render(fresh);
+        sample_counter += render(fresh);
         fresh = false;
-        sample_counter += 1;
     } while(std::chrono::system_clock::now() - start < render_time);
 
     return sample_counter;
 }
+
+Renderer::Stats Renderer::take_stats() {
+    Stats stats;
+    profiler.collect(&stats.kernel_time, &stats.transfer_time);
+
+    auto now = std::chrono::steady_clock::now();
+    stats.elapsed = duration(now - stats_start).count();
+    stats_start = now;
+
+    stats.passes = stats_passes;
+    stats.samples = stats_samples;
+    stats_passes = 0;
+    stats_samples = 0;
+
+    // 32-bit counter is read and reset every period, so it is
+    // expected to be called at least once per second or so.
+    if (config.count_rays) {
+        cl_uint count = 0;
+        const cl_uint zero = 0;
+        ray_counter.load(queue, &count, sizeof(cl_uint));
+        ray_counter.store(queue, &zero, sizeof(cl_uint));
+        stats.rays = count;
+    }
+
+    return stats;
+}
+
+long long Renderer::Stats::bounces() const {
+    return std::max(rays - samples, 0ll);
+}
+
+double Renderer::Stats::samples_per_second() const {
+    return elapsed > 0.0 ? samples/elapsed : 0.0;
+}
+double Renderer::Stats::rays_per_second() const {
+    return elapsed > 0.0 ? rays/elapsed : 0.0;
+}
+double Renderer::Stats::bounces_per_second() const {
+    return elapsed > 0.0 ? bounces()/elapsed : 0.0;
+}
@@ -1,12 +1,80 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <cassert>
+#include <algorithm>
+#include <memory>
+#include <chrono>
 #include <cstdint>
 
 #include <opencl/opencl.hpp>
+#include <wavefront.hpp>
+#include <adaptive.hpp>
+#include <temporal.hpp>
+#include <profiler.hpp>
+#include <scenario.hpp>
 
 #include <view.hh>
 #include <object.hh>
+#include <group.hh>
+#include <track.hh>
+
+// Makes every object a prototype with the single instance.
+inline void split_objects(
+    const std::vector<Object> &objs,
+    std::vector<ObjectPrototype> *protos,
+    std::vector<ObjectInstance> *insts
+) {
+    protos->resize(objs.size());
+    insts->resize(objs.size());
+    for (size_t i = 0; i < objs.size(); ++i) {
+        (*protos)[i] = object_prototype(&objs[i]);
+        (*insts)[i] = object_instance(&objs[i], (int)i);
+    }
+}
+
+// Earlier states of the scene during the frame, see `Renderer::store_objects`.
+// Empty previous state means the scene doesn't move.
+template <typename T>
+std::vector<std::vector<T>> single_keyframe(const std::vector<T> &prev) {
+    std::vector<std::vector<T>> frames;
+    if (prev.size() > 0) {
+        frames.push_back(prev);
+    }
+    return frames;
+}
+// Splits every keyframe, the prototypes are taken from the first one.
+inline void split_keyframes(
+    const std::vector<std::vector<Object>> &frames,
+    std::vector<ObjectPrototype> *protos,
+    std::vector<std::vector<ObjectInstance>> *insts
+) {
+    protos->clear();
+    insts->resize(frames.size());
+    std::vector<ObjectPrototype> frame_protos;
+    for (size_t k = 0; k < frames.size(); ++k) {
+        split_objects(frames[k], k == 0 ? protos : &frame_protos, &(*insts)[k]);
+    }
+}
+
+// Resamples the states evenly spaced in time to `count` ones,
+// `interpolate` is used between the nearest given states.
+template <typename T, typename F>
+std::vector<T> resample_keyframes(const std::vector<T> &frames, int count, F interpolate) {
+    assert(frames.size() > 0 && count > 1);
+    int n = (int)frames.size() - 1;
+    if (n + 1 == count) {
+        return frames;
+    }
+    std::vector<T> out(count);
+    for (int k = 0; k < count; ++k) {
+        double s = (double)(k*n)/(count - 1);
+        int j = std::min((int)s, std::max(n - 1, 0));
+        out[k] = n > 0 ? interpolate(frames[j], frames[j + 1], s - j) : frames[0];
+    }
+    return out;
+}
 
 // FIXME: Add `set_view()` method and use it instead of `fresh` argument
 class Renderer {
@@ -16,43 +84,306 @@ class Renderer {
             bool lens = false;
             bool motion = false;
             bool object_motion = false;
+            // States of the scene evenly spaced over the shutter interval
+            // including its both ends, the motion is interpolated piecewise
+            // between them. The states given are resampled to this number.
+            int keyframes = 2;
+        };
+        // Sampling only the pixels which are not converged yet.
+        struct Adaptive {
+            bool enabled = false;
+            // Pixel is converged when the standard error of its mean
+            // is below the threshold in every color channel.
+            double threshold = 0.01;
+            // Samples every pixel gets before the convergence test.
+            int min_samples = 16;
+            // The list of active pixels is updated every `interval` passes.
+            int interval = 4;
+        };
+
+        // Launching the single kernel as 2D ranges of tiles. The image
+        // is split into bands of tile rows launched one after another,
+        // so every launch is short and the image is updated band by band.
+        struct Tiled {
+            bool enabled = false;
+            // Work group size, a work group traces a tile of pixels.
+            int tile_width = 8;
+            int tile_height = 8;
+            // Target device time of a launch in seconds. The band height
+            // is fitted to it by the profiled time of the previous band,
+            // without `profiling` it stays at `chunk_rows`.
+            double chunk_time = 0.01;
+            int chunk_rows = 8;
+        };
+
+        // Samples per pixel traced by a single launch of the plain or the
+        // tiled kernel. They are summed in registers and the pixel is written
+        // once, which saves the launch overhead and the memory traffic of
+        // every sample at low resolutions. Other modes trace one per launch.
+        struct Batch {
+            int samples_per_launch = 1;
+            // In plain mode the number is fitted to the target device time
+            // of a launch by the profiled time of the previous one, up to
+            // the maximum. Without `profiling` it stays at the initial one.
+            bool auto_tune = false;
+            double launch_time = 0.01;
+            int max_samples_per_launch = 32;
+        };
+
+        // Reusing the samples of the previous views when the view changes.
+        struct Temporal {
+            bool enabled = false;
+            // Reprojected history counts as at most this number of samples,
+            // so the view-dependent shading of the old views fades out.
+            int max_history = 32;
+            // Hyperbolic distance between the first hits of the pixel
+            // in the old and the new view above which it's disoccluded.
+            double hit_tolerance = 0.05;
         };
 
         int path_max_depth = 6;
         int path_max_diffuse_depth = 2;
         Blur blur;
         double gamma = 2.2;
+        // Use scrambled Sobol sequences for the pixel, lens and
+        // bounce directions instead of independent random numbers.
+        bool low_discrepancy = true;
+        // Directory for built program binaries, empty to disable caching.
+        std::string cache_dir = "cache";
+        // Trace paths with separate kernels per stage instead of a single one.
+        bool wavefront = false;
+        // Cannot be used together with `wavefront`.
+        Adaptive adaptive = {};
+        // Cannot be used together with `wavefront` or `adaptive`.
+        Tiled tiled = {};
+        // Cannot be used together with `wavefront` or `adaptive`.
+        // Changes of the view and of the render size are reprojected,
+        // only the `fresh` rendering discards the accumulated samples.
+        Temporal temporal = {};
+        Batch batch = {};
+        // Measure device time of every command.
+        bool profiling = true;
+        // Count rays with a device atomic counter, it costs some performance.
+        bool count_rays = false;
+        // Keep the output images in host-visible memory and map them instead
+        // of reading back. It saves a copy on devices sharing memory with the
+        // host and makes the transfer from pinned memory on the others.
+        bool mapped_image = true;
+        // Rebuild the program for the stored scene: the object and tiling
+        // types absent from it are compiled out, and the scenes up to
+        // `specialize_max_objects` are traced by an unrolled loop with
+        // the types of the objects as constants instead of the BVH.
+        // The program is rebuilt only when that changes: objects added,
+        // removed or starting to move, not when they are moved.
+        bool specialize = false;
+        int specialize_max_objects = 64;
+    };
+
+    // Performance counters since the previous `take_stats` call.
+    struct Stats {
+        // Host time.
+        double elapsed = 0.0;
+        // Device time of the commands completed in this period.
+        double kernel_time = 0.0;
+        double transfer_time = 0.0;
+        // Rendering passes and pixel samples enqueued.
+        int passes = 0;
+        long long samples = 0;
+        // Rays cast on the device, zero unless `Config::count_rays` is set.
+        long long rays = 0;
+
+        // Every path ends with a ray that hits nothing or isn't continued,
+        // so the bounces are the rays beyond the first one of each sample.
+        long long bounces() const;
+
+        // Rates are per second of the host time.
+        double samples_per_second() const;
+        double rays_per_second() const;
+        double bounces_per_second() const;
     };
 
     private:
+    // Size of the output image.
     int width, height;
+    // Size the paths are traced at, it is smaller than the output
+    // if the render scale is below one. The accumulated colors in `screen`
+    // have this size and are upscaled to the output image.
+    int render_width = 0, render_height = 0;
+    double render_scale = 1.0;
+    // The accumulation is restarted by the next rendering.
+    bool size_changed = false;
+    Config config;
 
+    cl_device_id device;
     cl::Context context;
     cl::Queue queue;
+    // Readback goes through its own queue to overlap with rendering.
+    cl::Queue transfer_queue;
 
+    Profiler profiler;
+
+    // Source of `gen/scene.cl` the program is built with.
+    std::string scene_src;
     cl::Program program;
     cl::Kernel kernel;
+    cl::Kernel kernel_tiled;
+    cl::Kernel kernel_upscale;
+    cl::Kernel kernel_write;
+    cl::Kernel kernel_animate;
+    std::unique_ptr<Wavefront> wavefront;
+    std::unique_ptr<AdaptiveSampler> adaptive;
+    std::unique_ptr<TemporalReprojection> temporal;
+
+    // Ping-pong images: kernels write to the back one while the front one
+    // is being read back to `host_image` and presented.
+    cl::Buffer images[2];
+    cl::Event image_read[2];
+    // Pointers to the mapped images if `mapped_image` is set.
+    // The front image is mapped, the back one is unmapped before rendering.
+    uint8_t *image_maps[2] = {nullptr, nullptr};
+    int back = 0;
+    bool back_dirty = false;
+    std::vector<uint8_t> host_image;
 
-    cl::Buffer image;
     cl::Buffer screen;
 
-    cl::Buffer seeds;
     
-    cl::Buffer objects;
-    cl::Buffer objects_prev;
+    // Geometry is read for every object the ray is tested against,
+    // shading only for the nearest one, so they are stored apart.
+    // Geometry records are per instance, shading records are per prototype.
+    cl::Buffer objects_geometry;
+    // Paths of the instances between the keyframes, precomputed here
+    // so the device only evaluates them at the sample time.
+    // The segments of an instance are stored together.
+    cl::Buffer objects_motion;
+    cl::Buffer objects_shading;
+    cl::Buffer objects_shading_prev;
     cl::Buffer objects_mask;
     int object_count = 0;
+    int prototype_count = 0;
+
+    // Host copies needed to rebuild the hierarchy on partial updates.
+    std::vector<ObjectInstance> instances;
+    std::vector<bool> instances_mask;
+    // Kept for scene specialization only.
+    std::vector<ObjectPrototype> prototypes;
+
+    // Packed records are staged in the persistent vectors,
+    // so the updates don't allocate once the capacity is reached.
+    std::vector<ObjectGeometryPk> geometry_staging;
+    std::vector<MoebiusPathPk> motion_staging;
+    std::vector<ObjectShadingPk> shading_staging;
+    std::vector<uchar_pk> mask_staging;
+
+    cl::Buffer bvh_nodes;
+    cl::Buffer bvh_indices;
+    int bvh_node_count = 0;
+    int bvh_unbounded_count = 0;
+
+    cl::Buffer groups;
+    int group_count = 0;
+
+    // Animation tracks of the first `track_count` objects.
+    cl::Buffer tracks;
+    cl::Buffer track_keys;
+    int track_count = 0;
+    // Shading of all the track keys, the specialized program must handle
+    // it besides the `prototypes` the tracks are stored with.
+    std::vector<ObjectPrototype> track_prototypes;
 
-    static void store_objs_to_buf(
-        cl::Queue &queue, cl::Buffer &buf,
-        const std::vector<Object> &objs
+    // Records are written starting from the `first` one,
+    // the buffer grows if needed keeping the records before.
+    void store_prototypes_to_buf(
+        cl::Buffer &buf,
+        const std::vector<ObjectPrototype> &protos,
+        size_t first
+    );
+    void store_instances_to_buf(
+        cl::Buffer &buf,
+        const std::vector<ObjectInstance> &insts,
+        size_t first
+    );
+    // Empty `insts_keyframes` means the instances don't move during the frame.
+    void store_motion_to_buf(
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        size_t first
+    );
+    void store_mask_to_buf(
+        const std::vector<bool> &insts_mask,
+        size_t first
+    );
+    void store_bvh();
+    // Empty `protos_prev` means the prototypes don't change during the frame.
+    void store_scene(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectPrototype> &protos_prev,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
+    );
+    // Empty `protos` means the prototypes are not changed.
+    void update_scene(
+        int first,
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectPrototype> &protos_prev,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
     );
 
     int monte_carlo_counter = 0;
+    // Advanced by every fresh image, it is a part of the random number
+    // key, so the frames of an animation have independent noise.
+    int frame_counter = 0;
+    // The next band of tile rows of the pass in tiled mode,
+    // and the height of the bands, the last one may be lower.
+    int chunk_start = 0;
+    int chunk_rows = 0;
+    // Height of the band rendered by `last_render`.
+    int last_chunk_rows = 0;
+    // The most recent kernel launch.
+    cl::Event last_render;
+    // Samples per pixel of the next launch, and of the one in `last_render`
+    // in plain mode. The tiled pass in progress traces `pass_samples`.
+    int launch_samples = 1;
+    int last_launch_samples = 0;
+    int pass_samples = 1;
+
+    cl::Buffer ray_counter;
+    int stats_passes = 0;
+    long long stats_samples = 0;
+    std::chrono::steady_clock::time_point stats_start;
 
-    ViewPk view, view_prev;
+    ViewPk view;
+    // Segments of the camera motion between the keyframes.
+    cl::Buffer view_motion;
+    std::vector<ViewMotionPk> view_motion_staging;
 
     static std::string gen_config_src(const Config &config);
+    static std::string gen_scene_src(
+        const Config &config,
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<bool> &insts_mask
+    );
+    // Builds the program with the current `scene_src` and takes its kernels.
+    void build_program();
+    // Regenerates `scene_src` and rebuilds the program if it has changed.
+    void specialize_scene();
+
+    void update_render_size();
+
+    void render_temporal(
+        const size_t offset[2], const size_t size[2], const size_t local[2],
+        cl::Event *done
+    );
+    void render_wavefront(cl::Event *done);
+    void render_adaptive(bool fresh, cl::Event *done);
+    // Render a pass of at most `max_samples` samples per pixel,
+    // a new tiled pass takes it when it starts.
+    int render_pass(bool fresh, int max_samples);
+    bool render_chunk(bool fresh, int max_samples);
 
     public:
     Renderer(
@@ -60,6 +391,16 @@ class Renderer {
         int width, int height,
         const Config &config 
     );
+    ~Renderer();
+
+    // Reallocates the images and the per-pixel buffers for the new
+    // output size, the scene and the program are kept. The accumulation
+    // is restarted, and the pointer from `image_data` becomes invalid.
+    void resize(int width, int height);
+    // Traces the paths at `scale` of the output size in both dimensions
+    // and upscales the result, e.g. to keep the motion fluid.
+    // The accumulation is restarted if the size changes.
+    void set_render_scale(double scale);
 
     void store_objects(const std::vector<Object> &objs);
     void store_objects(
@@ -67,13 +408,116 @@ class Renderer {
         const std::vector<Object> &objs_prev,
         const std::vector<bool> &objs_mask
     );
+    // The earlier states of the objects over the shutter interval, evenly
+    // spaced in time from its opening, `objs` are at its closing.
+    // The shading is interpolated from the first one to the last one only.
+    void store_objects(
+        const std::vector<Object> &objs,
+        const std::vector<std::vector<Object>> &objs_keyframes,
+        const std::vector<bool> &objs_mask
+    );
+    // Instanced scene, the prototypes are uploaded once
+    // and every instance holds only its map and prototype index.
+    void store_objects(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectInstance> &insts
+    );
+    void store_objects(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<ObjectInstance> &insts_prev,
+        const std::vector<bool> &insts_mask
+    );
+    void store_objects(
+        const std::vector<ObjectPrototype> &protos,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
+    );
+    // Replaces the objects starting from `first` in place, the objects
+    // past the end are appended. Only the given records are packed and
+    // uploaded, and the BVH is rebuilt only if bounded objects change.
+    // This overload is for the scenes stored as a list of objects,
+    // the `i`-th object is both the `i`-th prototype and instance.
+    void update_objects(
+        int first,
+        const std::vector<Object> &objs,
+        const std::vector<Object> &objs_prev,
+        const std::vector<bool> &objs_mask
+    );
+    void update_objects(
+        int first,
+        const std::vector<Object> &objs,
+        const std::vector<std::vector<Object>> &objs_keyframes,
+        const std::vector<bool> &objs_mask
+    );
+    // Instanced scene, the prototypes are kept.
+    void update_objects(
+        int first,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<ObjectInstance> &insts_prev,
+        const std::vector<bool> &insts_mask
+    );
+    void update_objects(
+        int first,
+        const std::vector<ObjectInstance> &insts,
+        const std::vector<std::vector<ObjectInstance>> &insts_keyframes,
+        const std::vector<bool> &insts_mask
+    );
+    // Groups repeating the instances, they must be stored before
+    // the instances referring to them.
+    void store_groups(const std::vector<Group> &grps);
+    // The `i`-th track is the `i`-th object and prototype, the keys of all
+    // tracks are uploaded once and the objects are stored as at the first key.
+    // Then `set_time` evaluates the tracks on the device into the objects,
+    // so the host doesn't build and upload them every frame.
+    // The moving tracks are not bounded by the BVH.
+    void store_tracks(const std::vector<ObjectTrack> &trks);
+    // Objects of the tracks at `time`, they are blurred
+    // over the shutter interval from `time - shutter`.
+    void set_time(double time, double shutter);
     
+    // Makes the back image a front one and starts its readback.
+    // Rendering continues to the other image without waiting for it.
+    void swap_image();
+    // Copies the front image, waiting for its readback if needed.
     void load_image(uint8_t *data);
+    // Pixels of the front image without copying, waiting for them if needed.
+    // The pointer is valid until the next `swap_image`.
+    const uint8_t *image_data();
+    // Copies the accumulated linear colors, 3 floats per pixel
+    // of the render size, which is the output size unless it is scaled.
+    // Waits for all the rendering enqueued before.
+    void load_screen(float *data);
+
+    // Number of pixels sampled by the last pass in adaptive mode,
+    // otherwise it is the number of all pixels.
+    int active_pixel_count() const;
 
     void set_view(const View &v);
     void set_view(const View &v, const View &vp);
+    // The earlier views over the shutter interval, see `store_objects`.
+    void set_view(const View &v, const std::vector<View> &keyframes);
 
-    void render(bool fresh);
+    // Rendering functions only enqueue kernels keeping at most two of them
+    // in flight, so the last one may be still running on return.
+    // They return the number of samples per pixel rendered, a pass takes
+    // up to `Config::Batch::samples_per_launch` of them.
+    int render(bool fresh);
+    // Passes are shortened not to exceed `count`, except the tiled pass
+    // left unfinished by `render_for`: its bands already traced the number
+    // of samples it was started with, so it is completed with that number
+    // and may overshoot `count` by less than `samples_per_launch`.
     int render_n(int count, bool fresh);
+    // In tiled mode the pass may be left unfinished when the time is over,
+    // it is continued by the next call unless it is `fresh`. A fresh image
+    // is rendered completely at least once.
     int render_for(double sec, bool fresh);
+    // Renders the next band of the pass in tiled mode and
+    // returns whether the pass is completed by it.
+    bool render_chunk(bool fresh);
+
+    // Returns the counters and starts a new period. Commands which
+    // are still running are accounted in the next period.
+    Stats take_stats();
 };
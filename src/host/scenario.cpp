@@ -6,6 +6,7 @@
 #include <algorithm>
 
 #include <view.hh>
+#include <object.hh>
 
 
 Transition::Transition(double d) :
@@ -36,6 +37,30 @@ View SquareTransition::get_view(double p) const {
     );
 }
 
+void ObjectTrack::add_key(double time, const Object &obj) {
+    assert(times.size() == 0 || times.back() < time);
+    times.push_back(time);
+    keys.push_back(obj);
+}
+
+Object ObjectTrack::get_object(double time) const {
+    assert(keys.size() > 0);
+
+    auto i = std::upper_bound(times.begin(), times.end(), time);
+    if (i == times.begin()) {
+        return keys.front();
+    } else if (i == times.end()) {
+        return keys.back();
+    }
+
+    size_t k = i - times.begin();
+    real t = (time - times[k - 1])/(times[k] - times[k - 1]);
+    Object obj;
+    object_shading_interpolate(&obj, &keys[k - 1], &keys[k], t);
+    obj.map = mo_interpolate(keys[k - 1].map, keys[k].map, t);
+    return obj;
+}
+
 void PathScenario::add_transition(std::unique_ptr<Transition> t) {
     index.push_back(std::make_pair(
         std::move(t),
@@ -42,6 +42,19 @@ class SquareTransition : public LinearTransition {
     View get_view(double p) const override;
 };
 
+// Keyframed animation of a single object, the keys are added in time order.
+// The map moves along the geodesic path between the keys and the shading
+// changes linearly. Tracks are uploaded once by `Renderer::store_tracks`
+// and evaluated on the device, `get_object` is the same on the host.
+class ObjectTrack {
+    public:
+    std::vector<double> times;
+    std::vector<Object> keys;
+
+    void add_key(double time, const Object &obj);
+    Object get_object(double time) const;
+};
+
 class Scenario {
     public:
     virtual double duration() const = 0;
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <string>
+#include <functional>
+
 #include "base.hpp"
 
 #include <SDL2/SDL_image.h>
 
 
 namespace sdl {
-    void save_image(
+    // Both return false if the file cannot be written.
+    inline bool save_image(
         std::string filename,
         int width, int height,
         std::function<void(uint8_t *data)> store
@@ -21,8 +25,27 @@ namespace sdl {
 
         store((uint8_t*)surface->pixels);
 
-        assert(IMG_SavePNG(surface, filename.c_str()) == 0);
+        bool saved = IMG_SavePNG(surface, filename.c_str()) == 0;
+
+        SDL_FreeSurface(surface);
+        return saved;
+    }
+
+    // Encodes the RGBA pixels in place without copying them to a surface.
+    inline bool save_image(
+        std::string filename,
+        int width, int height,
+        const uint8_t *data
+    ) {
+        SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(
+            (void*)data, width, height, 32, 4*width,
+            0xff<<0, 0xff<<8, 0xff<<16, 0xff<<24
+        );
+        assert(surface != nullptr);
+
+        bool saved = IMG_SavePNG(surface, filename.c_str()) == 0;
 
         SDL_FreeSurface(surface);
+        return saved;
     }
 };
@@ -16,6 +16,26 @@ Viewer::Viewer(int width, int height) {
     renderer = SDL_CreateRenderer(window, -1, 0);
     assert(renderer != nullptr);
     
+    texture = nullptr;
+    resize(width, height);
+}
+Viewer::~Viewer() {
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+}
+
+bool Viewer::window_resized(int *w, int *h) const {
+    SDL_GetWindowSize(window, w, h);
+    return *w > 0 && *h > 0 && (*w != width || *h != height);
+}
+
+void Viewer::resize(int w, int h) {
+    width = w;
+    height = h;
+    if (texture != nullptr) {
+        SDL_DestroyTexture(texture);
+    }
     texture = SDL_CreateTexture(
         renderer,
         SDL_PIXELFORMAT_RGBA32,
@@ -24,11 +44,6 @@ Viewer::Viewer(int width, int height) {
     );
     assert(texture != nullptr);
 }
-Viewer::~Viewer() {
-    SDL_DestroyTexture(texture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-}
 
 void Viewer::display(std::function<void(uint8_t *data)> store) {
     {
@@ -41,3 +56,11 @@ void Viewer::display(std::function<void(uint8_t *data)> store) {
 
     SDL_RenderPresent(renderer);
 }
+
+void Viewer::display(const uint8_t *data) {
+    assert(SDL_UpdateTexture(texture, nullptr, data, 4*width) == 0);
+
+    assert(SDL_RenderCopy(renderer, texture, nullptr, nullptr) == 0);
+
+    SDL_RenderPresent(renderer);
+}
@@ -22,5 +22,13 @@ class Viewer {
     Viewer(int width=800, int height=600);
     ~Viewer();
 
+    // Whether the window size differs from the image size,
+    // e.g. the window is resized by the user.
+    bool window_resized(int *w, int *h) const;
+    // Recreates the texture for the images of the new size.
+    void resize(int w, int h);
+
     void display(std::function<void(uint8_t *data)> store);
+    // Uploads the RGBA pixels straight to the texture.
+    void display(const uint8_t *data);
 };
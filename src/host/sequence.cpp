@@ -0,0 +1,303 @@
+#include "sequence.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+
+#include <encoder.hpp>
+
+
+using duration = std::chrono::duration<double>;
+
+std::pair<int, int> sequence_range(const Scenario &scenario, const SequenceConfig &config) {
+    assert(config.part_count > 0 && config.part >= 0 && config.part < config.part_count);
+
+    int first = std::max(0, config.first);
+    int last = config.last;
+    if (last < 0) {
+        last = (int)std::floor(scenario.duration()*config.frame_rate) + 1;
+    }
+    last = std::max(first, last);
+
+    long count = last - first;
+    return std::make_pair(
+        first + (int)(count*config.part/config.part_count),
+        first + (int)(count*(config.part + 1)/config.part_count)
+    );
+}
+
+bool is_frame_pattern(const std::string &pattern) {
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') {
+            continue;
+        }
+        i += 1;
+        if (i < pattern.size() && pattern[i] == '%') {
+            continue;
+        }
+        while (i < pattern.size() && std::strchr("-+ #0", pattern[i]) != nullptr) {
+            i += 1;
+        }
+        while (i < pattern.size() && std::isdigit((unsigned char)pattern[i])) {
+            i += 1;
+        }
+        if (i < pattern.size() && pattern[i] == '.') {
+            i += 1;
+            while (i < pattern.size() && std::isdigit((unsigned char)pattern[i])) {
+                i += 1;
+            }
+        }
+        if (i >= pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i')) {
+            return false;
+        }
+        conversions += 1;
+    }
+    return conversions == 1;
+}
+
+static std::string frame_filename(const std::string &pattern, int frame) {
+    std::vector<char> buffer(pattern.size() + 32);
+    int len = snprintf(buffer.data(), buffer.size(), pattern.c_str(), frame);
+    assert(len >= 0 && len < (int)buffer.size());
+    return std::string(buffer.data());
+}
+
+static bool file_exists(const std::string &filename) {
+    return (bool)std::ifstream(filename);
+}
+
+// Objects which map differs in any of the earlier keyframes are motion blurred.
+static std::vector<bool> moving_mask(
+    const std::vector<Object> &objs,
+    const std::vector<std::vector<Object>> &objs_keyframes
+) {
+    std::vector<bool> mask(objs.size(), false);
+    for (const std::vector<Object> &frame : objs_keyframes) {
+        for (size_t i = 0; i < objs.size(); ++i) {
+            mask[i] = mask[i] || memcmp(&objs[i].map, &frame[i].map, sizeof(Moebius)) != 0;
+        }
+    }
+    return mask;
+}
+
+// Extends the range of changed objects `[first, second)` by the `i`-th one.
+static void extend_range(std::pair<int, int> *range, int i) {
+    if (range->first >= range->second) {
+        *range = std::make_pair(i, i + 1);
+    } else {
+        range->first = std::min(range->first, i);
+        range->second = std::max(range->second, i + 1);
+    }
+}
+
+// The structures are compared field by field, because their padding
+// is left unspecified in the objects built anew for every frame.
+static bool same_material(const Material &a, const Material &b) {
+    return
+        memcmp(&a.diffuse_color, &b.diffuse_color, sizeof(float3)) == 0 &&
+        a.gloss == b.gloss && a.transparency == b.transparency &&
+        memcmp(&a.glow, &b.glow, sizeof(float3)) == 0;
+}
+
+// The `edge` and the `rotation` of the tiling are derived from `{p,q}`.
+static bool same_tiling(const Tiling &a, const Tiling &b) {
+    return
+        a.type == b.type && a.p == b.p && a.q == b.q &&
+        a.cell_size == b.cell_size && a.border_width == b.border_width &&
+        same_material(a.border_material, b.border_material);
+}
+
+static bool same_object(const Object &a, const Object &b) {
+    if (
+        a.type != b.type || a.material_count != b.material_count ||
+        memcmp(&a.map, &b.map, sizeof(Moebius)) != 0 ||
+        !same_tiling(a.tiling, b.tiling)
+    ) {
+        return false;
+    }
+    for (int k = 0; k < std::min(a.material_count, MATERIAL_COUNT_MAX); ++k) {
+        if (!same_material(a.materials[k], b.materials[k])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Extends the range by the objects which differ between `a` and `b`.
+static void extend_range(
+    std::pair<int, int> *range,
+    const std::vector<Object> &a, const std::vector<Object> &b
+) {
+    assert(a.size() == b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!same_object(a[i], b[i])) {
+            extend_range(range, (int)i);
+        }
+    }
+}
+
+// Objects `[first, second)` of every keyframe.
+static std::vector<std::vector<Object>> slice_keyframes(
+    const std::vector<std::vector<Object>> &frames,
+    std::pair<int, int> range
+) {
+    std::vector<std::vector<Object>> slices;
+    for (const std::vector<Object> &frame : frames) {
+        slices.emplace_back(frame.begin() + range.first, frame.begin() + range.second);
+    }
+    return slices;
+}
+
+// If `a` is the average of `m` samples and `b` of `m + n` ones
+// the variance of `b` is the variance of `b - a` times `m/n`.
+static double estimate_noise(
+    const std::vector<float> &a, const std::vector<float> &b,
+    int m, int n
+) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        double d = std::min(std::max(b[i], 0.0f), 1.0f) - std::min(std::max(a[i], 0.0f), 1.0f);
+        sum += d*d;
+    }
+    return std::sqrt(sum/a.size()*m/n);
+}
+
+int render_sequence(
+    Renderer &renderer, int width, int height,
+    const Scenario &scenario,
+    const SequenceConfig &config
+) {
+    const double frame_time = 1.0/config.frame_rate;
+    assert(config.keyframes >= 2);
+    if (!is_frame_pattern(config.output)) {
+        throw std::invalid_argument(config.output);
+    }
+    const bool hdr = Encoder::is_hdr(config.output);
+    std::pair<int, int> range = sequence_range(scenario, config);
+
+    Encoder encoder(config.encoder_threads);
+    std::vector<float> screen(3*width*height), screen_prev;
+
+    // Objects of the previous frame as they are stored in the renderer.
+    bool stored = false;
+    std::vector<Object> stored_objs;
+    std::vector<std::vector<Object>> stored_keyframes;
+    std::vector<bool> stored_mask;
+
+    int written = 0;
+    for (int frame = range.first; frame < range.second; ++frame) {
+        std::string filename = frame_filename(config.output, frame);
+        if (config.skip_existing && file_exists(filename)) {
+            continue;
+        }
+        auto start = std::chrono::system_clock::now();
+
+        // The earlier keyframes are evenly spaced from the previous frame.
+        double time = frame*frame_time;
+        std::vector<View> views;
+        std::vector<std::vector<Object>> keyframes;
+        for (int k = 0; k + 1 < config.keyframes; ++k) {
+            double t = time - frame_time*(config.keyframes - 1 - k)/(config.keyframes - 1);
+            views.push_back(scenario.get_view(t));
+            keyframes.push_back(scenario.get_objects(t));
+        }
+        renderer.set_view(scenario.get_view(time), views);
+        std::vector<Object> objs = scenario.get_objects(time);
+        // The frame where the objects change their number is not blurred.
+        for (const std::vector<Object> &keyframe : keyframes) {
+            if (keyframe.size() != objs.size()) {
+                keyframes.clear();
+                break;
+            }
+        }
+        std::vector<bool> mask = moving_mask(objs, keyframes);
+        if (
+            !stored || objs.size() != stored_objs.size() ||
+            keyframes.size() != stored_keyframes.size()
+        ) {
+            renderer.store_objects(objs, keyframes, mask);
+        } else {
+            // Only the objects changed since the previous frame are uploaded.
+            std::pair<int, int> dirty = std::make_pair(0, 0);
+            extend_range(&dirty, objs, stored_objs);
+            for (size_t k = 0; k < keyframes.size(); ++k) {
+                extend_range(&dirty, keyframes[k], stored_keyframes[k]);
+            }
+            for (size_t i = 0; i < mask.size(); ++i) {
+                if (mask[i] != stored_mask[i]) {
+                    extend_range(&dirty, (int)i);
+                }
+            }
+            if (dirty.first < dirty.second) {
+                renderer.update_objects(
+                    dirty.first,
+                    std::vector<Object>(objs.begin() + dirty.first, objs.begin() + dirty.second),
+                    slice_keyframes(keyframes, dirty),
+                    std::vector<bool>(mask.begin() + dirty.first, mask.begin() + dirty.second)
+                );
+            }
+        }
+        stored = true;
+        stored_objs.swap(objs);
+        stored_keyframes.swap(keyframes);
+        stored_mask.swap(mask);
+
+        int samples = renderer.render_n(config.samples, true);
+        double noise = -1.0;
+        if (config.noise > 0.0) {
+            // Sample count is doubled until the noise is low enough.
+            renderer.load_screen(screen.data());
+            while (samples < config.max_samples) {
+                int n = std::min(samples, config.max_samples - samples);
+                renderer.render_n(n, false);
+                screen_prev.swap(screen);
+                screen.resize(screen_prev.size());
+                renderer.load_screen(screen.data());
+                noise = estimate_noise(screen_prev, screen, samples, n);
+                samples += n;
+                if (noise < config.noise) {
+                    break;
+                }
+            }
+        }
+
+        Encoder::Image image;
+        image.filename = filename;
+        image.width = width;
+        image.height = height;
+        if (hdr) {
+            image.hdr_data.resize(3*width*height);
+            renderer.load_screen(image.hdr_data.data());
+        } else {
+            image.data.resize(4*width*height);
+            renderer.swap_image();
+            renderer.load_image(image.data.data());
+        }
+        encoder.push(std::move(image));
+        written += 1;
+
+        duration elapsed = std::chrono::system_clock::now() - start;
+        std::cout << "Frame " << frame << " [" << range.first << ", " << range.second << "): " <<
+            samples << " samples";
+        if (noise >= 0.0) {
+            std::cout << ", noise " << noise;
+        }
+        std::cout << ", " << elapsed.count() << " s";
+        Renderer::Stats stats = renderer.take_stats();
+        std::cout << " (kernels " << stats.kernel_time <<
+            " s, transfers " << stats.transfer_time << " s)" << std::endl;
+    }
+    encoder.wait();
+
+    return written;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include <renderer.hpp>
+#include <scenario.hpp>
+
+
+// Settings of offline rendering of a scenario into an image sequence.
+struct SequenceConfig {
+    double frame_rate = 25.0;
+    // States of the scenario taken over the frame interval for motion blur,
+    // the renderer interpolates piecewise between them.
+    int keyframes = 2;
+
+    // Frames `[first, last)`, negative `last` means the end of the scenario.
+    int first = 0;
+    int last = -1;
+    // The frame range is split into `part_count` contiguous parts
+    // and only the `part`-th of them is rendered, so that the sequence
+    // can be distributed between processes or machines.
+    int part = 0;
+    int part_count = 1;
+
+    // Samples per pixel. If `noise` is positive the sampling continues
+    // until the estimated noise is below it or `max_samples` is reached.
+    int samples = 256;
+    double noise = 0.0;
+    int max_samples = 4096;
+
+    // Output file name pattern with a single integer conversion for
+    // the frame number, like `output/%05d.png`.
+    // The `.exr` extension writes linear colors instead of gamma-corrected.
+    std::string output = "output/%d.png";
+    // Don't render frames which files already exist.
+    bool skip_existing = false;
+    // Zero means the number of hardware threads.
+    int encoder_threads = 0;
+};
+
+// Range of the frames to render for the `config` part.
+std::pair<int, int> sequence_range(const Scenario &scenario, const SequenceConfig &config);
+
+// The output pattern is passed to `snprintf` as the format, so it must have
+// exactly one conversion and it must take an `int`. Only flags, width
+// and precision are accepted with it, and `%%` is the percent sign.
+bool is_frame_pattern(const std::string &pattern);
+
+// Renders the frames and returns the number of frames written.
+// Throws `std::invalid_argument` if the output pattern is not valid.
+int render_sequence(
+    Renderer &renderer, int width, int height,
+    const Scenario &scenario,
+    const SequenceConfig &config
+);
@@ -0,0 +1,44 @@
+#include "temporal.hpp"
+
+#include <cstring>
+#include <utility>
+
+
+TemporalReprojection::TemporalReprojection(cl_context context, cl_program program, int pixel_count) :
+    render(program, "render_temporal"),
+
+    hits(context, pixel_count*sizeof(cl_float4)),
+    sample_counts(context, pixel_count*sizeof(cl_int)),
+    screen_back(context, pixel_count*3*sizeof(cl_float)),
+    hits_back(context, pixel_count*sizeof(cl_float4)),
+    sample_counts_back(context, pixel_count*sizeof(cl_int))
+{}
+
+void TemporalReprojection::load_kernels(cl_program program) {
+    render = cl::Kernel(program, "render_temporal");
+}
+
+void TemporalReprojection::begin_pass(const ViewPk &view, int width, int height, bool fresh) {
+    this->fresh = fresh || !has_history;
+    reprojecting = !this->fresh && (
+        std::memcmp(&view, &history_view, sizeof(ViewPk)) != 0 ||
+        width != history_width || height != history_height
+    );
+    pass_view = view;
+    pass_width = width;
+    pass_height = height;
+}
+
+void TemporalReprojection::end_pass(cl::Buffer &screen) {
+    if (reprojecting) {
+        std::swap(screen, screen_back);
+        std::swap(hits, hits_back);
+        std::swap(sample_counts, sample_counts_back);
+    }
+    has_history = true;
+    history_view = pass_view;
+    history_width = pass_width;
+    history_height = pass_height;
+    fresh = false;
+    reprojecting = false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <opencl/opencl.hpp>
+
+#include <view.hh>
+
+
+// Kernel, device buffers and the history state of temporal
+// accumulation, see `src/device/temporal.cl`.
+class TemporalReprojection {
+    public:
+    cl::Kernel render;
+
+    // First hits and sample counts of the current image,
+    // its colors are in the renderer's `screen`.
+    cl::Buffer hits;
+    cl::Buffer sample_counts;
+    // The reprojecting pass writes to these buffers reading the current
+    // ones, and they are swapped with the current ones once it's completed.
+    cl::Buffer screen_back;
+    cl::Buffer hits_back;
+    cl::Buffer sample_counts_back;
+
+    // View and render size of the current image.
+    bool has_history = false;
+    ViewPk history_view;
+    int history_width = 0, history_height = 0;
+
+    // The pass in progress.
+    ViewPk pass_view;
+    int pass_width = 0, pass_height = 0;
+    bool fresh = true;
+    bool reprojecting = false;
+
+    TemporalReprojection(cl_context context, cl_program program, int pixel_count);
+    // Takes the kernels from the rebuilt `program`, the buffers are kept.
+    void load_kernels(cl_program program);
+
+    // Starts a pass, it reprojects the history if the view or the size
+    // have changed since it, and discards the history if `fresh`.
+    void begin_pass(const ViewPk &view, int width, int height, bool fresh);
+    // Makes the image of the completed pass the history,
+    // the renderer's `screen` is swapped if needed.
+    void end_pass(cl::Buffer &screen);
+};
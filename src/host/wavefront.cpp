@@ -0,0 +1,38 @@
+#include "wavefront.hpp"
+
+#include <algebra/moebius.hh>
+
+
+Wavefront::Wavefront(cl_context context, cl_program program, int path_count) :
+    generate(program, "wf_generate"),
+    intersect(program, "wf_intersect"),
+    shade(program, "wf_shade"),
+    accumulate(program, "wf_accumulate"),
+
+    ray_start(context, path_count*sizeof(cl_float4)),
+    ray_direction(context, path_count*sizeof(cl_float4)),
+    color(context, path_count*3*sizeof(cl_float)),
+    light(context, path_count*3*sizeof(cl_float)),
+    flags(context, path_count*sizeof(cl_int)),
+    prev(context, path_count*sizeof(cl_int)),
+    diffuse(context, path_count*sizeof(cl_int)),
+    time(context, path_count*sizeof(cl_float)),
+
+    hit_index(context, path_count*sizeof(cl_int)),
+    hit_pos(context, path_count*sizeof(cl_float4)),
+    hit_dir(context, path_count*sizeof(cl_float4)),
+    hit_flags(context, path_count*sizeof(cl_int)),
+    hit_element(context, path_count*sizeof(MoebiusPk)),
+
+    paths_a(context, path_count*sizeof(cl_int)),
+    paths_b(context, path_count*sizeof(cl_int)),
+    count_a(context, sizeof(cl_int)),
+    count_b(context, sizeof(cl_int))
+{}
+
+void Wavefront::load_kernels(cl_program program) {
+    generate = cl::Kernel(program, "wf_generate");
+    intersect = cl::Kernel(program, "wf_intersect");
+    shade = cl::Kernel(program, "wf_shade");
+    accumulate = cl::Kernel(program, "wf_accumulate");
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <opencl/opencl.hpp>
+
+
+// Kernels and device buffers of the wavefront path tracer,
+// see `src/device/wavefront.cl`. There is one path per pixel.
+class Wavefront {
+    public:
+    cl::Kernel generate;
+    cl::Kernel intersect;
+    cl::Kernel shade;
+    cl::Kernel accumulate;
+
+    cl::Buffer ray_start, ray_direction;
+    cl::Buffer color, light;
+    cl::Buffer flags, prev, diffuse, time;
+
+    cl::Buffer hit_index, hit_pos, hit_dir, hit_flags;
+    // Group element of the copy that was hit.
+    cl::Buffer hit_element;
+
+    // Lists of active paths and their lengths, they are swapped every bounce.
+    cl::Buffer paths_a, paths_b;
+    cl::Buffer count_a, count_b;
+
+    Wavefront(cl_context context, cl_program program, int path_count);
+    // Takes the kernels from the rebuilt `program`, the buffers are kept.
+    void load_kernels(cl_program program);
+};